@@ -0,0 +1,92 @@
+//
+// Histogram fills per second with the integer BinIndexer against the old floating point lookup.
+//
+
+#include "bench_util.h"
+#include "histogram.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+    constexpr size_t kNumValues = 1 << 16;
+
+    // The lookup Histogram::fill used before BinIndexer, a floor of a double division
+    struct DoubleHistogram {
+        uint32_t min_value;
+        uint32_t max_value;
+        uint32_t num_bins;
+        double bin_width;
+        std::vector<uint32_t> bins;
+        uint32_t below_range_count = 0;
+        uint32_t above_range_count = 0;
+
+        DoubleHistogram(uint32_t min, uint32_t max, uint32_t bins_count)
+            : min_value(min), max_value(max), num_bins(bins_count),
+              bin_width(static_cast<double>(max - min) / bins_count), bins(bins_count, 0) {}
+
+        void fill(uint32_t value) {
+            if (value < min_value) {
+                below_range_count++;
+            } else if (value >= max_value) {
+                above_range_count++;
+            } else {
+                int bin_index = static_cast<int>(std::floor((value - min_value) / bin_width));
+                if (bin_index >= 0 && bin_index < static_cast<int>(num_bins)) {
+                    bins[bin_index]++;
+                }
+            }
+        }
+    };
+
+    void run(const char* name, uint32_t min, uint32_t max, uint32_t num_bins, const std::vector<uint32_t>& values,
+             size_t iterations) {
+        DoubleHistogram old_histogram(min, max, num_bins);
+        Histogram histogram(min, max, num_bins);
+        const double old_ns = bench::bestNsPerIteration(iterations, [&] {
+            for (uint32_t value : values) old_histogram.fill(value);
+            bench::doNotOptimize(old_histogram.bins.data());
+        });
+        const double indexer_ns = bench::bestNsPerIteration(iterations, [&] {
+            for (uint32_t value : values) histogram.fill(value);
+            bench::doNotOptimize(histogram);
+        });
+        const double batch_ns = bench::bestNsPerIteration(iterations, [&] {
+            histogram.fill(values);
+            bench::doNotOptimize(histogram);
+        });
+        const double num_values = static_cast<double>(values.size());
+        std::printf("  %-34s double %6.0f  BinIndexer %6.0f  batch fill %6.0f  Mfills/s\n", name,
+                    num_values * 1e3 / old_ns, num_values * 1e3 / indexer_ns, num_values * 1e3 / batch_ns);
+    }
+
+    std::vector<uint32_t> uniformValues(std::mt19937& rng, uint32_t min, uint32_t max) {
+        std::uniform_int_distribution<uint32_t> distribution(min, max - 1);
+        std::vector<uint32_t> values(kNumValues);
+        for (auto& value : values) value = distribution(rng);
+        return values;
+    }
+
+    // Waveform-like, most samples near a baseline with a tail past the range
+    std::vector<uint32_t> baselineValues(std::mt19937& rng, double baseline, double sigma) {
+        std::normal_distribution<double> distribution(baseline, sigma);
+        std::vector<uint32_t> values(kNumValues);
+        for (auto& value : values) value = static_cast<uint32_t>(std::min(std::max(distribution(rng), 0.0), 4095.0));
+        return values;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const double scale = bench::scaleArg(argc, argv);
+    const size_t iterations = static_cast<size_t>(200 * scale) + 1;
+    std::mt19937 rng(1);
+
+    std::printf("%zu values per fill\n", kNumValues);
+    run("charge 1024-4096/16 uniform", 1024, 4096, 16, uniformValues(rng, 1024, 4096), iterations);
+    run("light 1596-4096/20 uniform", 1596, 4096, 20, uniformValues(rng, 1596, 4096), iterations);
+    run("charge, gaussian near baseline", 1024, 4096, 16, baselineValues(rng, 2048, 30), iterations);
+    run("light, gaussian near baseline", 1596, 4096, 20, baselineValues(rng, 2000, 30), iterations);
+    return 0;
+}
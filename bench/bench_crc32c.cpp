@@ -0,0 +1,58 @@
+//
+// Cost of the CRC32C trailer relative to serializing a full TpcMonitor snapshot.
+//
+
+#include "bench_util.h"
+#include "crc32c.h"
+#include "tpc_monitor.h"
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv) {
+    const double scale = bench::scaleArg(argc, argv);
+    const size_t iterations = static_cast<size_t>(20000 * scale) + 1;
+
+    // A snapshot with every channel filled, the size sent every monitoring period
+    TpcMonitor monitor;
+    std::mt19937 rng(1);
+    std::vector<uint32_t> charge(NUM_CHARGE_SAMPLES);
+    std::vector<uint32_t> light(NUM_LIGHT_SAMPLES);
+    for (size_t ch = 0; ch < NUM_CHARGE_CHANNELS; ch++) {
+        for (auto& sample : charge) sample = 1024 + rng() % 3072;
+        monitor.fillChargeChannel(ch, charge);
+    }
+    for (size_t ch = 0; ch < NUM_LIGHT_CHANNELS; ch++) {
+        for (auto& sample : light) sample = 1596 + rng() % 2500;
+        monitor.fillLightChannel(ch, light);
+    }
+
+    std::vector<uint32_t> out;
+    monitor.serialize_into_with_crc(out);
+    const size_t num_words = out.size() - 1;
+    const size_t num_bytes = num_words * sizeof(uint32_t);
+
+    const double plain_ns = bench::bestNsPerIteration(iterations, [&] {
+        out.clear();
+        monitor.serialize_into(out);
+        bench::doNotOptimize(out.data());
+    });
+    const double crc_ns = bench::bestNsPerIteration(iterations, [&] {
+        out.clear();
+        monitor.serialize_into_with_crc(out);
+        bench::doNotOptimize(out.data());
+    });
+    const double hw_ns = bench::bestNsPerIteration(iterations, [&] {
+        bench::doNotOptimize(crc32c::compute(out.data(), num_bytes));
+    });
+    const double sw_ns = bench::bestNsPerIteration(iterations, [&] {
+        bench::doNotOptimize(crc32c::computeSoftware(out.data(), num_bytes));
+    });
+
+    std::printf("TpcMonitor snapshot: %zu words, hardware CRC %s\n", num_words,
+                crc32c::isHardwareAccelerated() ? "yes" : "no");
+    std::printf("  serialize_into            %8.0f ns\n", plain_ns);
+    std::printf("  serialize_into_with_crc   %8.0f ns  overhead %.1f%%\n", crc_ns, 100.0 * (crc_ns - plain_ns) / plain_ns);
+    std::printf("  crc32c::compute           %8.0f ns  %.2f GB/s\n", hw_ns, num_bytes / hw_ns);
+    std::printf("  crc32c::computeSoftware   %8.0f ns  %.2f GB/s\n", sw_ns, num_bytes / sw_ns);
+    return 0;
+}
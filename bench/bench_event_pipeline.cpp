@@ -0,0 +1,60 @@
+//
+// Events per second through EventPipeline::processParallel against the serial process().
+//
+
+#include "bench_util.h"
+#include "event_pipeline.h"
+#include <thread>
+#include <vector>
+
+namespace {
+
+    constexpr uint32_t kNumEvents = 100;
+    constexpr int kRepeats = 5;
+
+    /**
+     * @brief Decode and fill the whole buffer through a fresh pipeline.
+     * @param pool nullptr for the serial path.
+     * @return Events per second of the fastest repeat.
+     */
+    double eventsPerSecond(const std::vector<uint32_t>& buffer, TaskPool* pool, size_t iterations) {
+        TpcMonitor monitor;
+        LbwStatsEngine lbw_stats;
+        EventPipeline pipeline(&monitor, &lbw_stats);
+        const double ns = bench::bestNsPerIteration(iterations, [&] {
+            if (pool) {
+                pipeline.processParallel(buffer, *pool);
+            } else {
+                pipeline.process(buffer);
+            }
+            bench::doNotOptimize(monitor);
+        }, kRepeats);
+        if (pipeline.getDecoder().getNumEvents() != kRepeats * iterations * kNumEvents) {
+            std::fprintf(stderr, "decoded %llu events, expected %zu\n",
+                         static_cast<unsigned long long>(pipeline.getDecoder().getNumEvents()),
+                         kRepeats * iterations * kNumEvents);
+        }
+        return kNumEvents * 1e9 / ns;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const double scale = bench::scaleArg(argc, argv);
+    const size_t iterations = static_cast<size_t>(4 * scale) + 1;
+
+    std::vector<uint32_t> buffer;
+    for (uint32_t event = 0; event < kNumEvents; event++) raw_event::appendSyntheticEvent(buffer, event, event + 1);
+
+    std::printf("%u full synthetic events, histograms and LBW stats, %u hardware threads\n", kNumEvents,
+                std::thread::hardware_concurrency());
+    const double serial_rate = eventsPerSecond(buffer, nullptr, iterations);
+    std::printf("  process()                      %7.0f events/s\n", serial_rate);
+    for (size_t num_threads = 0; num_threads < constants::daq_computer::NUM_CPUS; num_threads++) {
+        TaskPool pool(num_threads);
+        const double parallel_rate = eventsPerSecond(buffer, &pool, iterations);
+        std::printf("  processParallel(), %zu+1 threads %7.0f events/s  %5.2fx\n", num_threads, parallel_rate,
+                    parallel_rate / serial_rate);
+    }
+    return 0;
+}
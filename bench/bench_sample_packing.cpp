@@ -0,0 +1,145 @@
+//
+// Compression ratio and throughput of the sample packings on synthetic waveforms.
+//
+
+#include "bench_util.h"
+#include "constants.h"
+#include "sample_packing.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace constants::tpc_readout;
+
+namespace {
+
+    constexpr size_t kNumWaveforms = 200;
+    constexpr uint32_t kBaseline = 2048;
+
+    uint32_t clampAdc(double value) {
+        return static_cast<uint32_t>(std::min(std::max(std::lround(value), 0L), 4095L));
+    }
+
+    // A flat baseline with gaussian noise
+    std::vector<uint32_t> flatWaveform(std::mt19937& rng, size_t num_samples, double sigma) {
+        std::normal_distribution<double> noise(0.0, sigma);
+        std::vector<uint32_t> samples(num_samples);
+        for (auto& sample : samples) sample = clampAdc(kBaseline + noise(rng));
+        return samples;
+    }
+
+    // Charge-like: a slowly drifting baseline with noise and a few bipolar induction pulses
+    std::vector<uint32_t> chargeWaveform(std::mt19937& rng, size_t num_samples) {
+        std::normal_distribution<double> noise(0.0, 3.0);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<double> signal(num_samples, 0.0);
+        const double drift = 20.0 * uniform(rng);
+        for (int pulse = 0; pulse < 3; pulse++) {
+            const double centre = uniform(rng) * num_samples;
+            const double height = 100.0 + 400.0 * uniform(rng);
+            for (size_t i = 0; i < num_samples; i++) {
+                const double t = (i - centre) / 6.0;
+                signal[i] += -height * t * std::exp(-0.5 * t * t);
+            }
+        }
+        std::vector<uint32_t> samples(num_samples);
+        for (size_t i = 0; i < num_samples; i++) {
+            samples[i] = clampAdc(kBaseline + drift * std::sin(i * 0.01) + signal[i] + noise(rng));
+        }
+        return samples;
+    }
+
+    // Light-like: a PMT baseline with fast negative pulses and an exponential tail
+    std::vector<uint32_t> lightWaveform(std::mt19937& rng, size_t num_samples) {
+        std::normal_distribution<double> noise(0.0, 2.0);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<double> signal(num_samples, 0.0);
+        for (int pulse = 0; pulse < 2; pulse++) {
+            const size_t start = static_cast<size_t>(uniform(rng) * num_samples);
+            const double height = 200.0 + 1000.0 * uniform(rng);
+            for (size_t i = start; i < num_samples; i++) signal[i] -= height * std::exp(-(i - start) / 8.0);
+        }
+        std::vector<uint32_t> samples(num_samples);
+        for (size_t i = 0; i < num_samples; i++) samples[i] = clampAdc(kBaseline + signal[i] + noise(rng));
+        return samples;
+    }
+
+    std::vector<uint32_t> whiteNoise(std::mt19937& rng, size_t num_samples) {
+        std::vector<uint32_t> samples(num_samples);
+        for (auto& sample : samples) sample = rng() & sample_packing::kAdcMask;
+        return samples;
+    }
+
+    SamplePacking packWaveform(SamplePacking packing, const std::vector<uint32_t>& samples,
+                               std::vector<uint32_t>& out) {
+        if (packing == SamplePacking::kZeroSuppressed) {
+            return sample_packing::packZeroSuppressed(samples.data(), samples.size(), kBaseline, 20, 8, 16, out);
+        }
+        return sample_packing::pack(packing, samples.data(), samples.size(), out);
+    }
+
+    const char* packingName(SamplePacking packing) {
+        switch (packing) {
+            case SamplePacking::k16Bit: return "16-bit";
+            case SamplePacking::k12Bit: return "12-bit";
+            case SamplePacking::kRice: return "rice";
+            case SamplePacking::kZeroSuppressed: return "zero-supp";
+        }
+        return "?";
+    }
+
+    void run(const char* name, const std::vector<std::vector<uint32_t>>& waveforms, size_t iterations) {
+        std::printf("%s, %zu samples\n", name, waveforms.front().size());
+        std::vector<std::vector<uint32_t>> packed(waveforms.size());
+        std::vector<uint32_t> unpacked(waveforms.front().size() + 1);
+        const size_t input_bytes = waveforms.size() * waveforms.front().size() * sizeof(uint16_t);
+
+        for (SamplePacking packing : {SamplePacking::k16Bit, SamplePacking::k12Bit, SamplePacking::kRice,
+                                      SamplePacking::kZeroSuppressed}) {
+            // Decode what the encoder produced, which may be a fallback packing
+            std::vector<SamplePacking> used(waveforms.size());
+            size_t packed_words = 0;
+            size_t num_fallbacks = 0;
+            for (size_t w = 0; w < waveforms.size(); w++) {
+                used[w] = packWaveform(packing, waveforms[w], packed[w]);
+                packed_words += packed[w].size();
+                if (used[w] != packing) num_fallbacks++;
+            }
+            const double encode_ns = bench::bestNsPerIteration(iterations, [&] {
+                for (size_t w = 0; w < waveforms.size(); w++) packWaveform(packing, waveforms[w], packed[w]);
+                bench::doNotOptimize(packed.data());
+            });
+            const double decode_ns = bench::bestNsPerIteration(iterations, [&] {
+                for (size_t w = 0; w < waveforms.size(); w++) {
+                    sample_packing::unpack(used[w], packed[w].data(), packed[w].size(), unpacked.data());
+                }
+                bench::doNotOptimize(unpacked.data());
+            });
+            const double ratio = static_cast<double>(input_bytes) / (packed_words * sizeof(uint32_t));
+            std::printf("  %-10s ratio vs 16-bit %5.2fx  encode %7.0f MB/s  decode %7.0f MB/s  fallbacks %zu/%zu\n",
+                        packingName(packing), ratio, input_bytes * 1e3 / encode_ns, input_bytes * 1e3 / decode_ns,
+                        num_fallbacks, waveforms.size());
+        }
+    }
+
+} // namespace
+
+// MB/s counts the input as 16-bit samples, as they arrive from the readout
+int main(int argc, char** argv) {
+    const double scale = bench::scaleArg(argc, argv);
+    const size_t iterations = static_cast<size_t>(20 * scale) + 1;
+    std::mt19937 rng(1);
+
+    std::vector<std::vector<uint32_t>> flat, charge, light, noise;
+    for (size_t w = 0; w < kNumWaveforms; w++) {
+        flat.push_back(flatWaveform(rng, NUM_CHARGE_SAMPLES, 2.0));
+        charge.push_back(chargeWaveform(rng, NUM_CHARGE_SAMPLES));
+        light.push_back(lightWaveform(rng, NUM_LIGHT_SAMPLES));
+        noise.push_back(whiteNoise(rng, NUM_CHARGE_SAMPLES));
+    }
+    run("Flat baseline, sigma 2", flat, iterations);
+    run("Charge-like: drift, noise, induction pulses", charge, iterations);
+    run("Light-like: PMT pulses", light, iterations);
+    run("White noise", noise, iterations);
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+// Scaling of ShardedTpcMonitor fills from 1 to NUM_CPUS threads, against one TpcMonitor behind a mutex.
+//
+
+#include "bench_util.h"
+#include "sharded_tpc_monitor.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Events {
+        std::vector<uint32_t> charge;
+        std::vector<uint32_t> light;
+    };
+
+    Events makeEvents(size_t num_events) {
+        std::mt19937 rng(1);
+        Events events;
+        events.charge.resize(num_events * NUM_CHARGE_CHANNELS * NUM_CHARGE_SAMPLES);
+        events.light.resize(num_events * NUM_LIGHT_CHANNELS * NUM_LIGHT_SAMPLES);
+        for (auto& sample : events.charge) sample = 1900 + rng() % 300;
+        for (auto& sample : events.light) sample = 1900 + rng() % 300;
+        return events;
+    }
+
+    /**
+     * @brief Fill events_per_thread events from each of num_threads threads while the main thread
+     * takes a snapshot every millisecond, as the monitoring loop would.
+     * @param fill Called as fill(thread, charge, light) for each event.
+     * @return Events per second over all threads.
+     */
+    template <typename Fill, typename Snapshot>
+    double eventsPerSecond(size_t num_threads, size_t events_per_thread, const Events& events, size_t num_events,
+                           Fill&& fill, Snapshot&& snapshot) {
+        std::atomic<size_t> running{num_threads};
+        std::vector<std::thread> threads;
+        const auto start = Clock::now();
+        for (size_t t = 0; t < num_threads; t++) {
+            threads.emplace_back([&, t] {
+                for (size_t i = 0; i < events_per_thread; i++) {
+                    const size_t event = (t + i) % num_events;
+                    fill(t, events.charge.data() + event * NUM_CHARGE_CHANNELS * NUM_CHARGE_SAMPLES,
+                         events.light.data() + event * NUM_LIGHT_CHANNELS * NUM_LIGHT_SAMPLES);
+                }
+                running--;
+            });
+        }
+        while (running.load() > 0) {
+            snapshot();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for (auto& thread : threads) thread.join();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        snapshot();
+        return num_threads * events_per_thread / seconds;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const double scale = bench::scaleArg(argc, argv);
+    const size_t events_per_thread = static_cast<size_t>(2000 * scale) + 1;
+    constexpr size_t kNumEvents = 16;
+    const Events events = makeEvents(kNumEvents);
+    const size_t max_threads = constants::daq_computer::NUM_CPUS;
+
+    std::printf("%zu events of %zu charge x %zu and %zu light x %zu samples per thread, %u hardware threads\n",
+                events_per_thread, NUM_CHARGE_CHANNELS, NUM_CHARGE_SAMPLES, NUM_LIGHT_CHANNELS, NUM_LIGHT_SAMPLES,
+                std::thread::hardware_concurrency());
+    double single_thread_rate = 0.0;
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads++) {
+        ShardedTpcMonitor sharded(num_threads);
+        TpcMonitor sharded_snapshot;
+        const double sharded_rate = eventsPerSecond(num_threads, events_per_thread, events, kNumEvents,
+            [&](size_t thread, const uint32_t* charge, const uint32_t* light) {
+                sharded.shard(thread).fillEvent(charge, NUM_CHARGE_SAMPLES, light, NUM_LIGHT_SAMPLES);
+            },
+            [&] { sharded.snapshot(sharded_snapshot); });
+
+        // The alternative without sharding, every fill and snapshot takes one lock
+        TpcMonitor locked;
+        TpcMonitor locked_snapshot;
+        std::mutex mutex;
+        const double locked_rate = eventsPerSecond(num_threads, events_per_thread, events, kNumEvents,
+            [&](size_t, const uint32_t* charge, const uint32_t* light) {
+                std::lock_guard<std::mutex> lock(mutex);
+                locked.fillEvent(charge, NUM_CHARGE_SAMPLES, light, NUM_LIGHT_SAMPLES);
+            },
+            [&] {
+                std::lock_guard<std::mutex> lock(mutex);
+                locked_snapshot.clear();
+                locked_snapshot.merge(locked);
+                locked.clear();
+            });
+
+        if (num_threads == 1) single_thread_rate = sharded_rate;
+        std::printf("  %zu threads  sharded %7.0f events/s  %5.2fx of 1 thread   mutex %7.0f events/s\n", num_threads,
+                    sharded_rate, sharded_rate / single_thread_rate, locked_rate);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+//
+// Timing helpers shared by the benchmarks.
+//
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+namespace bench {
+
+    // Keep the compiler from optimizing away a result the benchmark does not otherwise use
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * @brief Run body iterations times per repeat and keep the fastest repeat.
+     * @return Nanoseconds per iteration of the fastest repeat.
+     */
+    template <typename Body>
+    double bestNsPerIteration(size_t iterations, Body&& body, int repeats = 15) {
+        double best = 1e300;
+        for (int r = 0; r < repeats; r++) {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++) body();
+            const auto stop = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::nano>(stop - start).count() / iterations);
+        }
+        return best;
+    }
+
+    // Optional first command line argument scaling the iteration counts, e.g. 0.1 for a quick run
+    inline double scaleArg(int argc, char** argv) {
+        return argc > 1 ? std::max(std::atof(argv[1]), 1e-3) : 1.0;
+    }
+
+} // namespace bench
+
+#endif //BENCH_UTIL_H
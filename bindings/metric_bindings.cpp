@@ -13,6 +13,13 @@
 #include "../include/tpc_readout_monitor.h"
 #include "../include/tpc_monitor_charge_event.h"
 #include "../include/tpc_monitor_light_event.h"
+#include "../include/tpc_monitor_query.h"
+#include "../include/telemetry_packet.h"
+#include "../include/telemetry_stream_decoder.h"
+#include "../include/metric_merge.h"
+#include "../include/lbw_stats_engine.h"
+#include "../include/event_block.h"
+#include "../include/zero_suppression.h"
 #include "CommunicationCodes.hh"
 
 namespace py = pybind11;
@@ -24,24 +31,29 @@ public:
     // Inherit constructors
     using MetricBase::MetricBase;
 
-    std::vector<uint32_t> serialize() const override {
-        PYBIND11_OVERRIDE_PURE(
-            std::vector<uint32_t>, /* Return type */
-            MetricBase,           /* Parent class */
-            serialize             /* Function name */
-        );
+    // Trampoline for the pure virtual serialize_into, a python override implements serialize()
+    // and its words are appended to the output buffer.
+    void serialize_into(std::vector<uint32_t>& out) const override {
+        py::gil_scoped_acquire gil;
+        py::function override = py::get_override(static_cast<const MetricBase*>(this), "serialize");
+        if (override) {
+            auto words = override().cast<std::vector<uint32_t>>();
+            out.insert(out.end(), words.begin(), words.end());
+            return;
+        }
+        py::pybind11_fail("Tried to call pure virtual function \"MetricBase::serialize\"");
     }
 
-    // Trampoline for the pure virtual deserialize
-    std::vector<uint32_t>::const_iterator deserialize(
-        std::vector<uint32_t>::const_iterator begin,
-        std::vector<uint32_t>::const_iterator end) override {
-        PYBIND11_OVERRIDE_PURE(
-            std::vector<uint32_t>::const_iterator, /* Return type */
-            MetricBase,                           /* Parent class */
-            deserialize,                          /* Function name */
-            begin, end                            /* Arguments */
-        );
+    // Trampoline for the pure virtual deserialize. Raw pointers can't cross into python
+    // so the override receives the words as a list and is assumed to consume all of them.
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override {
+        py::gil_scoped_acquire gil;
+        py::function override = py::get_override(static_cast<const MetricBase*>(this), "deserialize");
+        if (override) {
+            override(std::vector<uint32_t>(begin, end));
+            return end;
+        }
+        py::pybind11_fail("Tried to call pure virtual function \"MetricBase::deserialize\"");
     }
 
     // Trampoline for the pure virtual getMetricDict
@@ -54,6 +66,46 @@ public:
     }
 };
 
+// Convert a decoded telemetry record to a python dictionary, handing the metric object over to python
+static py::dict recordToDict(const RecordHeader& header, std::unique_ptr<MetricBase> metric) {
+    py::dict record;
+    record["code"] = header.code;
+    record["version"] = header.version;
+    record["flags"] = header.flags;
+    record["sequence"] = header.sequence;
+    if (metric) {
+        record["metric"] = py::cast(std::move(metric));
+    } else {
+        record["metric"] = py::none();
+    }
+    return record;
+}
+
+// Streaming decoder which collects the records completed during each feed() for python
+class PyTelemetryStreamDecoder {
+public:
+    PyTelemetryStreamDecoder()
+        : decoder_([this](const RecordHeader& header, std::unique_ptr<MetricBase> metric) {
+              records_.append(recordToDict(header, std::move(metric)));
+          }) {}
+
+    py::list feed(const py::buffer& buffer) {
+        py::buffer_info info = buffer.request();
+        if (info.ndim != 1 || info.strides[0] != info.itemsize) {
+            throw std::runtime_error("Stream decoding failed: buffer must be 1D and C-contiguous.");
+        }
+        records_ = py::list();
+        decoder_.feed(static_cast<const uint8_t*>(info.ptr), static_cast<size_t>(info.size) * info.itemsize);
+        return records_;
+    }
+
+    TelemetryStreamDecoder& decoder() { return decoder_; }
+
+private:
+    py::list records_;
+    TelemetryStreamDecoder decoder_;
+};
+
 // The PYBIND11_MODULE macro creates the entry point for the Python module.
 // The first argument is the module name. It MUST match the filename of the final library.
 PYBIND11_MODULE(datamon, m) {
@@ -64,6 +116,11 @@ PYBIND11_MODULE(datamon, m) {
     py::class_<MetricBase, PyMetricBase /* trampoline */>(m, "MetricBase")
         .def(py::init<>())
         .def("deserialize", static_cast<void (MetricBase::*)(const std::vector<uint32_t>&)>(&MetricBase::deserialize), "Deserialize data from a list of integers.")
+        .def("deserialize_buffer", &MetricBase::deserializeBuffer, py::arg("buffer"),
+             "Deserialize in place from bytes, memoryview or a numpy array, returns the number of words consumed.")
+        .def("serialize_with_crc", &MetricBase::serialize_with_crc, "Serialize with a CRC32C trailer word appended.")
+        .def("deserialize_with_crc", static_cast<void (MetricBase::*)(const std::vector<uint32_t>&)>(&MetricBase::deserialize_with_crc),
+             "Verify the CRC32C trailer and deserialize, raises if the checksum does not match.")
         .def("get_metric_dict", &MetricBase::getMetricDict, "Deserialize data and return a dictionary.");
 
     // Command enum class bindings
@@ -97,13 +154,25 @@ PYBIND11_MODULE(datamon, m) {
         // TPC Readout
         .value("ColHardwareStatus", pgrams::communication::TelemetryCodes::TPC_Hardware_Status)
         .value("ColQueryHardwareStatus", pgrams::communication::TelemetryCodes::TPC_Query_Hardware_Status)
+        // TPC Data Monitor
+        .value("MonLowBwData", pgrams::communication::TelemetryCodes::TPCMonitor_LB_Data)
+        .value("MonHistograms", pgrams::communication::TelemetryCodes::TPCMonitor_Histograms)
+        .value("MonChargeEvent", pgrams::communication::TelemetryCodes::TPCMonitor_Charge_Event)
+        .value("MonLightEvent", pgrams::communication::TelemetryCodes::TPCMonitor_Light_Event)
+        .value("MonQuery", pgrams::communication::TelemetryCodes::TPCMonitor_Query)
+        .value("MonChargeEventBlock", pgrams::communication::TelemetryCodes::TPCMonitor_Charge_Event_Block)
+        .value("MonLightEventBlock", pgrams::communication::TelemetryCodes::TPCMonitor_Light_Event_Block)
         .export_values();
 
     // Bind the Histogram class
     py::class_<Histogram, MetricBase>(m, "Histogram")
         .def(py::init<>()) // Bind the default constructor
         .def(py::init<uint32_t, uint32_t, uint32_t>()) // Bind the parameterized constructor
-        .def("fill", &Histogram::fill, "Fill the histogram with a value")
+        .def("fill", static_cast<void (Histogram::*)(uint32_t)>(&Histogram::fill), "Fill the histogram with a value")
+        .def("fill", static_cast<void (Histogram::*)(const std::vector<uint32_t>&)>(&Histogram::fill),
+             "Fill the histogram with a list of values")
+        .def("merge", &Histogram::merge, py::arg("other"), "Add the counts of a histogram with the same binning")
+        .def("__iadd__", &Histogram::operator+=, py::is_operator())
         .def("clear", &Histogram::clear, "Clear the histogram data")
         .def("serialize", &Histogram::serialize, "Serialize the histogram to a list of ints")
 
@@ -118,11 +187,26 @@ PYBIND11_MODULE(datamon, m) {
     py::class_<TpcMonitor, MetricBase>(m, "TpcMonitor")
         .def(py::init<>())
         .def("clear", &TpcMonitor::clear)
+        .def("merge", &TpcMonitor::merge, py::arg("other"), "Add the histograms of another monitor")
+        .def("__iadd__", &TpcMonitor::operator+=, py::is_operator())
         .def("serialize", &TpcMonitor::serialize)
+        .def("fill_charge_channel", static_cast<void (TpcMonitor::*)(size_t, const std::vector<uint32_t>&)>(&TpcMonitor::fillChargeChannel),
+             py::arg("channel"), py::arg("samples"), "Fill a charge channel histogram with a whole waveform")
+        .def("fill_light_channel", static_cast<void (TpcMonitor::*)(size_t, const std::vector<uint32_t>&)>(&TpcMonitor::fillLightChannel),
+             py::arg("channel"), py::arg("samples"), "Fill a light channel histogram with a whole waveform")
 
-        // Expose the histograms (e.g., as read-only properties)
-        .def_property_readonly("charge_histograms", &TpcMonitor::getChargeHistograms)
-        .def_property_readonly("light_histograms", &TpcMonitor::getLightHistograms);
+        // Expose the histograms (e.g., as read-only properties), copied out of the dense blocks
+        // so they stay valid independent of the monitor
+        .def_property_readonly("charge_histograms", [](const TpcMonitor& self) {
+            std::vector<Histogram> hists;
+            for (const auto& view : self.getChargeHistograms()) hists.push_back(view.toHistogram());
+            return hists;
+        })
+        .def_property_readonly("light_histograms", [](const TpcMonitor& self) {
+            std::vector<Histogram> hists;
+            for (const auto& view : self.getLightHistograms()) hists.push_back(view.toHistogram());
+            return hists;
+        });
 
     // Bind the LowBwTpcMonitor class
     py::class_<LowBwTpcMonitor, MetricBase>(m, "LowBwTpcMonitor")
@@ -130,18 +214,90 @@ PYBIND11_MODULE(datamon, m) {
         .def("clear", &LowBwTpcMonitor::clear)
         .def("serialize", &LowBwTpcMonitor::serialize);
 
+    // Baseline/RMS/hit count engine feeding the LowBwTpcMonitor
+    py::class_<LbwStatsConfig>(m, "LbwStatsConfig")
+        .def(py::init<>())
+        .def_readwrite("charge_hit_threshold", &LbwStatsConfig::charge_hit_threshold)
+        .def_readwrite("light_roi_threshold", &LbwStatsConfig::light_roi_threshold)
+        .def_readwrite("clip_sigma", &LbwStatsConfig::clip_sigma)
+        .def_readwrite("clip_iterations", &LbwStatsConfig::clip_iterations);
+
+    py::class_<LbwStatsEngine>(m, "LbwStatsEngine")
+        .def(py::init<const LbwStatsConfig&>(), py::arg("config") = LbwStatsConfig())
+        .def("add_charge_event", [](LbwStatsEngine& self, const std::vector<uint32_t>& samples) {
+            self.addChargeEvent(samples.data(), samples.size() / NUM_CHARGE_CHANNELS);
+        }, py::arg("samples"), "Add an event of all charge waveforms flattened channel by channel")
+        .def("add_light_event", [](LbwStatsEngine& self, const std::vector<uint32_t>& samples) {
+            self.addLightEvent(samples.data(), samples.size() / NUM_LIGHT_CHANNELS);
+        }, py::arg("samples"), "Add an event of all light waveforms flattened channel by channel")
+        .def("publish", &LbwStatsEngine::publish, py::arg("monitor"), "Write the averages into a LowBwTpcMonitor")
+        .def("clear", &LbwStatsEngine::clear)
+        .def_property_readonly("num_charge_events", &LbwStatsEngine::getNumChargeEvents)
+        .def_property_readonly("num_light_events", &LbwStatsEngine::getNumLightEvents);
+
+    py::enum_<SamplePacking>(m, "SamplePacking")
+        .value("Packed16Bit", SamplePacking::k16Bit)
+        .value("Packed12Bit", SamplePacking::k12Bit)
+        .value("Rice", SamplePacking::kRice)
+        .value("ZeroSuppressed", SamplePacking::kZeroSuppressed)
+        .export_values();
+
     // Bind the TpcMonitorChargeEvent class
     py::class_<TpcMonitorChargeEvent, MetricBase>(m, "TpcMonitorChargeEvent")
         .def(py::init<>())
         .def("clear", &TpcMonitorChargeEvent::clear)
+        .def("set_charge_samples", &TpcMonitorChargeEvent::setChargeSamples, py::arg("samples"), py::arg("packing") = SamplePacking::k16Bit)
+        .def("set_charge_samples_zero_suppressed",
+             py::overload_cast<const std::vector<uint32_t>&, uint32_t, uint32_t, uint32_t, uint32_t>(
+                 &TpcMonitorChargeEvent::setChargeSamplesZeroSuppressed),
+             py::arg("samples"), py::arg("baseline"), py::arg("threshold"), py::arg("pre_samples"), py::arg("post_samples"))
         .def("serialize", &TpcMonitorChargeEvent::serialize);
 
+    py::class_<ZeroSuppressionConfig>(m, "ZeroSuppressionConfig")
+        .def(py::init<>())
+        .def_static("from_tpc_configs", &ZeroSuppressionConfig::fromTpcConfigs, py::arg("configs"))
+        .def_readwrite("threshold_sigma", &ZeroSuppressionConfig::threshold_sigma)
+        .def_readwrite("min_threshold", &ZeroSuppressionConfig::min_threshold)
+        .def_readwrite("pre_samples", &ZeroSuppressionConfig::pre_samples)
+        .def_readwrite("post_samples", &ZeroSuppressionConfig::post_samples);
+
+    py::class_<ZeroSuppressor>(m, "ZeroSuppressor")
+        .def(py::init<const ZeroSuppressionConfig&>(), py::arg("config") = ZeroSuppressionConfig())
+        .def("set_channels", &ZeroSuppressor::setChannels, py::arg("monitor"), "Thresholds from a LowBwTpcMonitor")
+        .def("set_channel", &ZeroSuppressor::setChannel, py::arg("channel"), py::arg("baseline"), py::arg("rms"))
+        .def("set_charge_samples", &ZeroSuppressor::setChargeSamples, py::arg("event"), py::arg("samples"))
+        .def("get_baseline", &ZeroSuppressor::getBaseline, py::arg("channel"))
+        .def("get_threshold", &ZeroSuppressor::getThreshold, py::arg("channel"));
+
     // Bind the TpcMonitorLightEvent class
     py::class_<TpcMonitorLightEvent, MetricBase>(m, "TpcMonitorLightEvent")
         .def(py::init<>())
         .def("clear", &TpcMonitorLightEvent::clear)
+        .def("set_light_samples", &TpcMonitorLightEvent::setLightSamples, py::arg("samples"), py::arg("packing") = SamplePacking::k16Bit)
         .def("serialize", &TpcMonitorLightEvent::serialize);
 
+    // Whole-event blocks, the dict holds a 2D samples array
+    py::class_<EventBlock, MetricBase>(m, "EventBlock")
+        .def("clear", &EventBlock::clear)
+        .def("set_samples", [](EventBlock& self, py::array_t<uint32_t, py::array::c_style | py::array::forcecast> samples,
+                               SamplePacking packing) {
+            if (samples.ndim() != 2 || static_cast<size_t>(samples.shape(0)) != self.getNumChannels()) {
+                throw std::invalid_argument("EventBlock samples must be a 2D array of " +
+                                            std::to_string(self.getNumChannels()) + " channels");
+            }
+            self.setSamples(samples.data(), samples.shape(1), packing);
+        }, py::arg("samples"), py::arg("packing") = SamplePacking::k16Bit, "Set every channel from a (channels, samples) array")
+        .def("serialize", &EventBlock::serialize)
+        .def_property_readonly("channels", &EventBlock::getChannels)
+        .def_property_readonly("num_samples", &EventBlock::getNumSamples)
+        .def("print", &EventBlock::print);
+
+    py::class_<ChargeEventBlock, EventBlock>(m, "ChargeEventBlock")
+        .def(py::init<>());
+
+    py::class_<LightEventBlock, EventBlock>(m, "LightEventBlock")
+        .def(py::init<>());
+
     // Bind the TpcConfigs class
     py::class_<TpcConfigs, MetricBase>(m, "TpcConfig")
         .def(py::init<>())
@@ -173,5 +329,52 @@ PYBIND11_MODULE(datamon, m) {
         .def_property_readonly("memory_usage", &DaqCompMonitor::getMemoryUsage)
         .def_property_readonly("disk_temp", &DaqCompMonitor::getDiskTemp)
         .def_property_readonly("cpu_temp", &DaqCompMonitor::getCpuTemp);
-}
 
+    // Bind the TpcMonitorQuery class
+    py::class_<TpcMonitorQuery, MetricBase>(m, "TpcMonitorQuery")
+        .def(py::init<>())
+        .def("clear", &TpcMonitorQuery::clear)
+        .def("serialize", &TpcMonitorQuery::serialize);
+
+    // Framed multi-metric telemetry packets
+    py::class_<TelemetryPacketEncoder>(m, "TelemetryPacketEncoder")
+        .def(py::init<>())
+        .def("begin", &TelemetryPacketEncoder::begin, "Start a new, empty frame")
+        .def("add", &TelemetryPacketEncoder::add, py::arg("code"), py::arg("metric"), py::arg("flags") = 0,
+             "Append a metric record to the frame, returns its sequence number")
+        .def("finish", &TelemetryPacketEncoder::finish, "Complete the frame and return its words")
+        .def_property_readonly("num_records", &TelemetryPacketEncoder::getNumRecords)
+        .def_property("next_sequence", &TelemetryPacketEncoder::getNextSequence,
+                      &TelemetryPacketEncoder::setNextSequence);
+
+    m.def("sum_tpc_monitors", &metric_merge::reduce<TpcMonitor>, py::arg("monitors"), py::arg("num_threads") = 1,
+          "Sum the histograms of many monitors, e.g. the snapshots of a run, with a tree reduction.");
+
+    m.attr("RECORD_FLAG_CRC32C") = TelemetryPacket::kFlagCrc32c;
+
+    m.def("decode_packet", [](const py::buffer& buffer) {
+        py::buffer_info info = buffer.request();
+        std::vector<uint32_t> aligned_copy;
+        auto [begin, num_words] = MetricBase::bufferWords(info, aligned_copy);
+
+        std::vector<DecodedMetric> metrics;
+        TelemetryPacketDecoder().decode(begin, begin + num_words, metrics);
+
+        py::list records;
+        for (auto& decoded : metrics) {
+            records.append(recordToDict(decoded.header, std::move(decoded.metric)));
+        }
+        return records;
+    }, py::arg("buffer"), "Decode a telemetry frame from bytes, memoryview or numpy into a list of records.");
+
+    py::class_<PyTelemetryStreamDecoder>(m, "TelemetryStreamDecoder")
+        .def(py::init<>())
+        .def("feed", &PyTelemetryStreamDecoder::feed, py::arg("chunk"),
+             "Feed the next chunk of the byte stream, returns the records completed by it")
+        .def("reset", [](PyTelemetryStreamDecoder& self) { self.decoder().reset(); })
+        .def_property_readonly("stream_offset", [](PyTelemetryStreamDecoder& self) { return self.decoder().getStreamOffset(); })
+        .def_property_readonly("num_frames", [](PyTelemetryStreamDecoder& self) { return self.decoder().getNumFrames(); })
+        .def_property_readonly("num_resyncs", [](PyTelemetryStreamDecoder& self) { return self.decoder().getNumResyncs(); })
+        .def_property_readonly("num_skipped_bytes", [](PyTelemetryStreamDecoder& self) { return self.decoder().getNumSkippedBytes(); })
+        .def_property_readonly("num_corrupt_frames", [](PyTelemetryStreamDecoder& self) { return self.decoder().getNumCorruptFrames(); });
+}
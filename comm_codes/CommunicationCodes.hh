@@ -136,7 +136,15 @@ enum class TelemetryCodes : uint16_t {
   HUB_Telemetry_Normal = 0x0,
   ORC_Hardware_Status = construct_code(0x20, COM_SUBSYSTEM_ORC_MSK),
   TPC_Hardware_Status = construct_code(0x20, COM_SUBSYSTEM_TPC_MSK),
-  TPC_Query_Hardware_Status = construct_code(0x22, COM_SUBSYSTEM_TPC_MSK)
+  TPC_Query_Hardware_Status = construct_code(0x22, COM_SUBSYSTEM_TPC_MSK),
+  // TPC Data Monitor
+  TPCMonitor_LB_Data = construct_code(0x20, COM_SUBSYSTEM_TPCMonitor_MSK),
+  TPCMonitor_Histograms = construct_code(0x21, COM_SUBSYSTEM_TPCMonitor_MSK),
+  TPCMonitor_Charge_Event = construct_code(0x22, COM_SUBSYSTEM_TPCMonitor_MSK),
+  TPCMonitor_Light_Event = construct_code(0x23, COM_SUBSYSTEM_TPCMonitor_MSK),
+  TPCMonitor_Query = construct_code(0x24, COM_SUBSYSTEM_TPCMonitor_MSK),
+  TPCMonitor_Charge_Event_Block = construct_code(0x25, COM_SUBSYSTEM_TPCMonitor_MSK),
+  TPCMonitor_Light_Event_Block = construct_code(0x26, COM_SUBSYSTEM_TPCMonitor_MSK)
 };
 
 constexpr uint16_t to_telem_u16(TelemetryCodes code) noexcept {
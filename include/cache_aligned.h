@@ -0,0 +1,44 @@
+//
+// Cache line alignment helpers for the dense monitoring buffers.
+//
+
+#ifndef CACHE_ALIGNED_H
+#define CACHE_ALIGNED_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Cache line size on the x86 and ARM flight computers
+constexpr size_t kCacheLineSize = 64;
+
+/**
+ * Allocator handing out storage that starts on a cache line, so a std::vector can back a buffer
+ * whose rows are padded to whole cache lines.
+ */
+template <typename T>
+class CacheAlignedAllocator {
+public:
+    using value_type = T;
+
+    CacheAlignedAllocator() noexcept = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{kCacheLineSize}));
+    }
+    void deallocate(T* p, size_t) noexcept {
+        ::operator delete(p, std::align_val_t{kCacheLineSize});
+    }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const noexcept { return false; }
+};
+
+template <typename T>
+using CacheAlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+#endif //CACHE_ALIGNED_H
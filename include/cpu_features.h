@@ -0,0 +1,54 @@
+//
+// Runtime CPU feature checks used to pick between SIMD kernels and their scalar fallbacks.
+//
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Kernels for newer instruction sets are compiled with per-function target attributes and only
+// selected when the CPU running the code supports them, no global compiler flags are needed.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define DATAMON_X86_DISPATCH 1
+#endif
+
+namespace cpu_features {
+
+    inline bool hasSse2() {
+#ifdef DATAMON_X86_DISPATCH
+        static const bool supported = __builtin_cpu_supports("sse2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    inline bool hasSsse3() {
+#ifdef DATAMON_X86_DISPATCH
+        static const bool supported = __builtin_cpu_supports("ssse3");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    inline bool hasSse42() {
+#ifdef DATAMON_X86_DISPATCH
+        static const bool supported = __builtin_cpu_supports("sse4.2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    inline bool hasAvx2() {
+#ifdef DATAMON_X86_DISPATCH
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+} // namespace cpu_features
+
+#endif //CPU_FEATURES_H
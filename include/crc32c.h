@@ -0,0 +1,36 @@
+//
+// CRC32C (Castagnoli) checksum used for the metric integrity trailers.
+//
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace crc32c {
+
+    /**
+     * @brief CRC32C of a byte range.
+     * @details Uses the SSE4.2 / ARMv8 CRC instructions when the CPU has them, otherwise a
+     * slice-by-8 table. Chain calls by passing the previous result as crc.
+     * @param data Pointer to the first byte.
+     * @param num_bytes Number of bytes to checksum.
+     * @param crc The CRC of any preceding data, 0 to start a new checksum.
+     * @return The CRC32C of all data so far.
+     */
+    uint32_t compute(const void* data, size_t num_bytes, uint32_t crc = 0);
+
+    // Table driven version, always available. Gives identical results to compute().
+    uint32_t computeSoftware(const void* data, size_t num_bytes, uint32_t crc = 0);
+
+    // True if compute() runs on the hardware CRC instructions
+    bool isHardwareAccelerated();
+
+    inline uint32_t compute(const uint32_t* begin, const uint32_t* end, uint32_t crc = 0) {
+        return compute(begin, static_cast<size_t>(end - begin) * sizeof(uint32_t), crc);
+    }
+
+} // namespace crc32c
+
+#endif //CRC32C_H
@@ -24,7 +24,7 @@ private:
     std::array<uint32_t, NUM_CPUS> cpu_temp_;
 
     // Implement  the serialize/deserialize
-    size_t num_members_ = 10;
+    static constexpr size_t num_members_ = 10;
     auto member_tuple() {
         return std::tie(error_bit_word_, last_command_, last_command_status_, daq_bit_word_, tpc_disk_,
                         tof_disk_, sys_disk_, cpu_usage_, memory_usage_, disk_temp_);
@@ -37,6 +37,10 @@ private:
 public:
     DaqCompMonitor();
 
+    // Fixed wire layout: scalar members followed by the CPU temperatures
+    using Layout = WireLayout<num_members_, NUM_CPUS>;
+    static constexpr size_t kWireWords = Layout::kWireWords;
+
     // Assign errors to the bits in the error word
     enum ErrorBits : uint32_t {
         cpu_temp_status = 1,
@@ -98,9 +102,10 @@ public:
     const std::array<uint32_t, NUM_CPUS> getCpuTemp() const { return cpu_temp_; }
 
     // MetricBase interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    std::array<uint32_t, kWireWords> serialize_array() const;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 
 #ifdef USE_PYTHON
     py::dict getMetricDict() override;
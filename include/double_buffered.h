@@ -0,0 +1,104 @@
+//
+// Two copies of a metric so the readout thread keeps filling while the other copy is sent.
+//
+
+#ifndef DOUBLE_BUFFERED_H
+#define DOUBLE_BUFFERED_H
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "cache_aligned.h"
+#include "metric_base.h"
+
+/**
+ * A MetricBase type kept twice, one copy filled by a producer thread while the other is
+ * serialized and cleared by a consumer thread.
+ *
+ * The producer brackets its fills with update(). The consumer retires the active copy with
+ * swap(), a single atomic operation which never waits, then consume() hands the retired copy out
+ * once any fill that started before the swap has finished, and clears it for reuse.
+ *
+ * Both sides share one atomic state word: bit 0 is the active copy and bits 1 and 2 mark the
+ * producer inside copy 0 or 1. There must be one producer and one consumer thread.
+ */
+template <typename Metric>
+class DoubleBuffered {
+    static_assert(std::is_base_of_v<MetricBase, Metric>, "DoubleBuffered holds MetricBase types");
+
+public:
+    template <typename... Args>
+    explicit DoubleBuffered(const Args&... args) : buffers_{Metric(args...), Metric(args...)} {}
+
+    /**
+     * @brief Producer side, fill the active copy.
+     * @param fill Called as fill(Metric&), it must not keep the reference.
+     */
+    template <typename Fill>
+    void update(Fill&& fill) {
+        // Mark both copies busy, then release the one which is not active. A swap in between only
+        // makes the consumer wait for this fill, which it has to anyway.
+        const uint32_t active = state_.fetch_or(kBusy0 | kBusy1, std::memory_order_seq_cst) & kActive;
+        state_.fetch_and(~busyBit(active ^ 1), std::memory_order_release);
+        struct Section {
+            std::atomic<uint32_t>& state;
+            uint32_t busy;
+            ~Section() { state.fetch_and(~busy, std::memory_order_release); }
+        } section{state_, busyBit(active)};
+        fill(buffers_[active]);
+    }
+
+    /**
+     * @brief Consumer side, retire the active copy so fills go to the other one.
+     * @return False, without swapping, if the previously retired copy has not been consumed yet.
+     */
+    bool swap() {
+        if (retired_pending_) return false;
+        retired_ = state_.fetch_xor(kActive, std::memory_order_seq_cst) & kActive;
+        retired_pending_ = true;
+        return true;
+    }
+
+    /**
+     * @brief Consumer side, hand out the retired copy and clear it.
+     * @details Swaps first if nothing is retired. Waits only for a fill that was already running
+     * on the retired copy. The copy is cleared even if consume throws.
+     * @param consume Called as consume(const Metric&).
+     */
+    template <typename Consume>
+    void consume(Consume&& consume) {
+        swap();
+        while (state_.load(std::memory_order_acquire) & busyBit(retired_)) std::this_thread::yield();
+        // Clear even if consume throws, the copy must not be handed out twice
+        struct Release {
+            Metric& retired;
+            bool& pending;
+            ~Release() {
+                retired.clear();
+                pending = false;
+            }
+        } release{buffers_[retired_], retired_pending_};
+        consume(static_cast<const Metric&>(release.retired));
+    }
+
+    // Consumer side, append the retired copy to a telemetry buffer, see consume()
+    void serialize_into(std::vector<uint32_t>& out) {
+        consume([&out](const Metric& metric) { metric.serialize_into(out); });
+    }
+
+private:
+    static constexpr uint32_t kActive = 0x1;
+    static constexpr uint32_t kBusy0 = 0x2;
+    static constexpr uint32_t kBusy1 = 0x4;
+    static constexpr uint32_t busyBit(uint32_t index) { return index == 0 ? kBusy0 : kBusy1; }
+
+    // Shared between both threads, on its own cache line
+    alignas(kCacheLineSize) std::atomic<uint32_t> state_{0};
+    // Consumer thread only
+    alignas(kCacheLineSize) uint32_t retired_ = 0;
+    bool retired_pending_ = false;
+    Metric buffers_[2];
+};
+
+#endif //DOUBLE_BUFFERED_H
@@ -0,0 +1,149 @@
+//
+// A whole charge or light event in one metric, every channel sharing one header.
+//
+
+#ifndef EVENT_BLOCK_H
+#define EVENT_BLOCK_H
+
+#include "metric_base.h"
+#include "sample_packing.h"
+
+using namespace constants::tpc_readout;
+
+/**
+ * All channel waveforms of one event, the alternative to one TpcMonitorChargeEvent or
+ * TpcMonitorLightEvent per channel.
+ *
+ * Wire format:
+ *  run_number, file_number, evt_number
+ *  format      [31:28] SamplePacking, [27:0] samples per channel
+ *  num_words   payload words
+ *  mask        ceil(num_channels / 32) words, bit c % 32 of word c / 32 set if channel c is present
+ *  payload     the present channels in channel order, each packedWords(packing, samples) words
+ *
+ * Every channel has the same number of samples and a fixed-size payload, so only the 16-bit and
+ * 12-bit packings are supported. Channels are added in increasing order and appended to the
+ * payload, so it is built and serialized in a single pass.
+ */
+class EventBlock : public MetricBase {
+private:
+    size_t num_channels_;
+    uint32_t run_number_;
+    uint32_t file_number_;
+    uint32_t evt_number_;
+    // [31:28] SamplePacking, [27:0] samples per channel
+    uint32_t format_;
+    uint32_t num_words_;
+    std::vector<uint32_t> channel_mask_;
+    std::vector<uint32_t> payload_;
+    // Next channel addChannel() accepts
+    size_t next_channel_;
+    std::vector<uint32_t> pack_scratch_;
+
+    static constexpr uint32_t kPackingShift = 28;
+    static constexpr uint32_t kSamplesMask = (1u << kPackingShift) - 1;
+
+    // Implement  the serialize/deserialize
+    static constexpr size_t num_members_ = 5;
+    auto member_tuple() {
+        return std::tie(run_number_, file_number_, evt_number_, format_, num_words_);
+    };
+    auto member_tuple() const {
+        return std::tie(run_number_, file_number_, evt_number_, format_, num_words_);
+    };
+
+    void checkChannel(size_t channel) const;
+    // Pack one channel into its channelWords() payload words
+    void packChannel(const uint32_t* samples, size_t num_samples, uint32_t* words);
+    // Payload words of one channel
+    size_t channelWords() const { return sample_packing::packedWords(getPacking(), getNumSamples()); }
+
+protected:
+    explicit EventBlock(size_t num_channels);
+
+public:
+    void clear();
+    void print();
+
+    void setRunNumber(uint32_t run_number) { run_number_ = run_number; }
+    void setFileNumber(uint32_t file_number) { file_number_ = file_number; }
+    void setEvtNumber(uint32_t evt_number) { evt_number_ = evt_number; }
+
+    /**
+     * @brief Start a new event, dropping the channels of the previous one.
+     * @param num_samples Samples every channel will have.
+     * @param packing k16Bit or k12Bit, throws std::invalid_argument otherwise.
+     */
+    void begin(size_t num_samples, SamplePacking packing = SamplePacking::k16Bit);
+
+    /**
+     * @brief Append one channel of the current event.
+     * @throws std::invalid_argument if the channel is not above the last one added, or
+     * num_samples does not match begin().
+     */
+    void addChannel(size_t channel, const uint32_t* samples, size_t num_samples);
+    // Append a channel already packed two per word, (num_samples + 1) / 2 words, needs k16Bit
+    void addChannelPacked(size_t channel, const uint32_t* words, size_t num_samples);
+
+    // Set every channel from channel-major samples, num_channels * num_samples values
+    void setSamples(const uint32_t* samples, size_t num_samples, SamplePacking packing = SamplePacking::k16Bit);
+    void setSamples(const std::vector<uint32_t>& samples, size_t num_samples,
+                    SamplePacking packing = SamplePacking::k16Bit) {
+        if (samples.size() != num_channels_ * num_samples) {
+            throw std::invalid_argument("EventBlock needs " + std::to_string(num_channels_) + " x " +
+                                        std::to_string(num_samples) + " samples, got " + std::to_string(samples.size()));
+        }
+        setSamples(samples.data(), num_samples, packing);
+    }
+
+    // Preallocate the payload for a full event, so building one of at most num_samples per channel never allocates
+    void reserve(size_t num_samples, SamplePacking packing = SamplePacking::k16Bit) {
+        payload_.reserve(num_channels_ * sample_packing::packedWords(packing, num_samples));
+    }
+
+    // --- Getter Methods ---
+    size_t getNumChannels() const { return num_channels_; }
+    uint32_t getRunNumber() const { return run_number_; }
+    uint32_t getFileNumber() const { return file_number_; }
+    uint32_t getEvtNumber() const { return evt_number_; }
+    SamplePacking getPacking() const { return static_cast<SamplePacking>(format_ >> kPackingShift); }
+    size_t getNumSamples() const { return format_ & kSamplesMask; }
+    const std::vector<uint32_t>& getChannelMask() const { return channel_mask_; }
+    bool hasChannel(size_t channel) const;
+    size_t getNumPresentChannels() const;
+    // Channel numbers in payload order
+    std::vector<uint32_t> getChannels() const;
+    const std::vector<uint32_t>& getPayload() const { return payload_; }
+    // Unpacked samples of a present channel, throws std::out_of_range otherwise
+    std::vector<uint32_t> getChannelSamples(size_t channel) const;
+    /**
+     * @brief Unpack every present channel, row by row in payload order.
+     * @param samples Space for getNumPresentChannels() * getNumSamples() values.
+     */
+    void unpackAll(uint32_t* samples) const;
+
+    // MetricBase interface implementation
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
+
+#ifdef USE_PYTHON
+    // samples is a 2D (present channels, samples) numpy array, channels the matching channel numbers
+    py::dict getMetricDict() override;
+#endif
+
+};
+
+// All NUM_CHARGE_CHANNELS charge channels of an event
+class ChargeEventBlock : public EventBlock {
+public:
+    ChargeEventBlock() : EventBlock(NUM_CHARGE_CHANNELS) {}
+};
+
+// All NUM_LIGHT_CHANNELS light channels of an event
+class LightEventBlock : public EventBlock {
+public:
+    LightEventBlock() : EventBlock(NUM_LIGHT_CHANNELS) {}
+};
+
+#endif //EVENT_BLOCK_H
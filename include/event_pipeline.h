@@ -0,0 +1,109 @@
+//
+// Single pass from raw event buffers to the monitor metrics.
+//
+
+#ifndef EVENT_PIPELINE_H
+#define EVENT_PIPELINE_H
+
+#include <functional>
+#include "raw_event_decoder.h"
+#include "task_pool.h"
+#include "tpc_monitor.h"
+#include "lbw_stats_engine.h"
+#include "load_shedder.h"
+#include "tpc_monitor_charge_event.h"
+#include "tpc_monitor_light_event.h"
+
+/**
+ * Decodes raw event buffers and feeds every channel span to the monitor stages while it is hot
+ * in cache: the TpcMonitor histograms, the LbwStatsEngine and, every snapshot interval events,
+ * the TpcMonitorChargeEvent/TpcMonitorLightEvent snapshots. The samples are read straight from
+ * the raw buffer, only the snapshots copy them.
+ *
+ * processParallel() decodes a whole buffer first and then fans the fills out over a TaskPool,
+ * each task owning a group of channels for the whole buffer. No two tasks touch the same channel,
+ * so they fill the stages directly with no locks or merging, and every channel sees its samples
+ * in the same order as with process().
+ *
+ * With a LoadShedder attached, each decoded event is processed fully, histogrammed only or
+ * skipped as it decides. Skipped events are still decoded, so the marker counts stay exact.
+ *
+ * The stages are owned by the caller and may be nullptr to skip them. The pipeline itself is not
+ * thread-safe, use one per readout thread.
+ */
+class EventPipeline {
+public:
+    // Called once per channel of a snapshot event, the metric is reused for the next channel
+    using ChargeSnapshotCallback = std::function<void(const TpcMonitorChargeEvent&)>;
+    using LightSnapshotCallback = std::function<void(const TpcMonitorLightEvent&)>;
+
+    EventPipeline(TpcMonitor* monitor, LbwStatsEngine* lbw_stats);
+    // The decoder callback points back at this pipeline
+    EventPipeline(const EventPipeline&) = delete;
+    EventPipeline& operator=(const EventPipeline&) = delete;
+
+    /**
+     * @brief Snapshot every interval-th decoded event, 0 turns the snapshots off.
+     * @details Either callback may be empty to snapshot only charge or only light channels.
+     */
+    void setSnapshots(uint32_t interval, ChargeSnapshotCallback on_charge, LightSnapshotCallback on_light);
+    // Ask the shedder how much work each event gets, nullptr processes every event fully
+    void setLoadShedder(LoadShedder* shedder) { shedder_ = shedder; }
+    void setRunNumber(uint32_t run_number) { run_number_ = run_number; }
+    void setFileNumber(uint32_t file_number) { file_number_ = file_number; }
+
+    // See RawEventDecoder::decode(), an incomplete trailing event is left unconsumed
+    const uint32_t* process(const uint32_t* begin, const uint32_t* end) { return decoder_.decode(begin, end); }
+    void process(const std::vector<uint32_t>& buffer) { decoder_.decode(buffer); }
+
+    /**
+     * @brief Like process(), with the histogram and LBW fills spread over a task pool.
+     * @details Snapshots are still taken on the calling thread while decoding.
+     */
+    const uint32_t* processParallel(const uint32_t* begin, const uint32_t* end, TaskPool& pool);
+    void processParallel(const std::vector<uint32_t>& buffer, TaskPool& pool) {
+        processParallel(buffer.data(), buffer.data() + buffer.size(), pool);
+    }
+
+    // Write the decoder marker counts into the readout monitor
+    void publish(TpcReadoutMonitor& monitor) const { decoder_.publish(monitor); }
+    const RawEventDecoder& getDecoder() const { return decoder_; }
+    RawEventDecoder& getDecoder() { return decoder_; }
+
+    // Channels handled by one task of processParallel()
+    static constexpr size_t kChannelsPerTask = 16;
+
+private:
+    void processEvent(const DecodedEvent& event);
+    // Full fills feed the LBW statistics too, otherwise only the histograms
+    void fillCharge(const ChannelSpan& span, bool full);
+    void fillLight(const ChannelSpan& span, bool full);
+
+    struct TaskSpan {
+        ChannelSpan span;
+        bool full;
+    };
+
+
+    RawEventDecoder decoder_;
+    TpcMonitor* monitor_;
+    LbwStatsEngine* lbw_stats_;
+    LoadShedder* shedder_ = nullptr;
+
+    uint32_t snapshot_interval_ = 0;
+    uint32_t events_to_snapshot_ = 0;
+    ChargeSnapshotCallback on_charge_snapshot_;
+    LightSnapshotCallback on_light_snapshot_;
+    TpcMonitorChargeEvent charge_snapshot_;
+    TpcMonitorLightEvent light_snapshot_;
+    uint32_t run_number_ = 0;
+    uint32_t file_number_ = 0;
+
+    // processParallel() collects the spans per task while decoding instead of filling
+    bool collect_ = false;
+    std::vector<std::vector<TaskSpan>> task_spans_;
+    uint32_t num_collected_charge_events_ = 0;
+    uint32_t num_collected_light_events_ = 0;
+};
+
+#endif //EVENT_PIPELINE_H
@@ -0,0 +1,174 @@
+//
+// Bounded hand-off of raw event buffers from the readout thread to the monitor pipeline.
+//
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "cache_aligned.h"
+#include "tpc_readout_monitor.h"
+
+/**
+ * Single-producer/single-consumer ring of preallocated event slots.
+ *
+ * The readout thread copies an event into the next free slot with tryPush(), or reads it straight
+ * into the slot with beginWrite()/commit(). The monitor thread processes the oldest event in
+ * place with consume() and so frees its slot. All memory is allocated in the constructor, neither
+ * side ever takes a lock or allocates and neither waits for the other: a full ring drops the new
+ * event and counts it as an overflow, for TpcReadoutMonitor::setNumRwBufferOverflow().
+ *
+ * Head and tail sit on their own cache lines, each next to the owning side's cached copy of the
+ * other index, so the two threads only share a cache line when the cached index runs out.
+ */
+class EventRing {
+public:
+    /**
+     * @param num_slots Number of events the ring holds, rounded up to a power of two.
+     * @param slot_words Capacity of each slot in words, larger events count as overflows.
+     */
+    EventRing(size_t num_slots, size_t slot_words)
+        : num_slots_(roundUpPow2(num_slots)), mask_(num_slots_ - 1), slot_words_(slot_words),
+          slots_(num_slots_ * slot_words), sizes_(num_slots_, 0) {
+        if (num_slots == 0 || slot_words == 0) {
+            throw std::invalid_argument("EventRing needs at least one slot of one word, got " +
+                                        std::to_string(num_slots) + " slots of " + std::to_string(slot_words));
+        }
+    }
+    EventRing(const EventRing&) = delete;
+    EventRing& operator=(const EventRing&) = delete;
+
+    // --- Producer side ---
+
+    /**
+     * @brief Copy one event into the ring.
+     * @return False if the ring is full or the event does not fit a slot, the event is dropped and counted.
+     */
+    bool tryPush(const uint32_t* words, size_t num_words) {
+        uint32_t* slot = beginWrite();
+        if (slot == nullptr || num_words > slot_words_) return fail(num_words > slot_words_);
+        std::memcpy(slot, words, num_words * sizeof(uint32_t));
+        commit(num_words);
+        return true;
+    }
+
+    /**
+     * @brief Next free slot to write an event into, slotWords() words of space, or nullptr if full.
+     * @details Nothing is visible to the consumer until commit(). A nullptr is not counted as an
+     * overflow, call dropEvent() if the event is given up.
+     */
+    uint32_t* beginWrite() {
+        const size_t head = producer_.head.load(std::memory_order_relaxed);
+        if (head - producer_.cached_tail == num_slots_) {
+            producer_.cached_tail = consumer_.tail.load(std::memory_order_acquire);
+            if (head - producer_.cached_tail == num_slots_) return nullptr;
+        }
+        return slotData(head);
+    }
+
+    // Publish the event written into the slot from beginWrite()
+    void commit(size_t num_words) {
+        const size_t head = producer_.head.load(std::memory_order_relaxed);
+        if (num_words > slot_words_) {
+            throw std::out_of_range("EventRing commit of " + std::to_string(num_words) +
+                                    " words exceeds the slot size " + std::to_string(slot_words_));
+        }
+        sizes_[head & mask_] = num_words;
+        producer_.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Count an event the producer gave up on, e.g. after beginWrite() returned nullptr
+    void dropEvent() { fail(false); }
+
+    // --- Consumer side ---
+
+    /**
+     * @brief Process the oldest event in place and free its slot.
+     * @param process Called as process(const uint32_t* words, size_t num_words), it must not keep the pointer.
+     * @return False if the ring was empty.
+     */
+    template <typename Process>
+    bool consume(Process&& process) {
+        const size_t tail = consumer_.tail.load(std::memory_order_relaxed);
+        if (tail == consumer_.cached_head) {
+            consumer_.cached_head = producer_.head.load(std::memory_order_acquire);
+            if (tail == consumer_.cached_head) return false;
+        }
+        // Free the slot even if processing throws, the event is not retried
+        struct Release {
+            std::atomic<size_t>& tail;
+            size_t next;
+            ~Release() { tail.store(next, std::memory_order_release); }
+        } release{consumer_.tail, tail + 1};
+        process(static_cast<const uint32_t*>(slotData(tail)), sizes_[tail & mask_]);
+        return true;
+    }
+
+    // Process every event queued at the time of the call, returns how many
+    template <typename Process>
+    size_t consumeAll(Process&& process) {
+        const size_t available = size();
+        size_t count = 0;
+        while (count < available && consume(process)) count++;
+        return count;
+    }
+
+    // --- Either side ---
+
+    // Events queued, exact only on the consumer side
+    size_t size() const {
+        return producer_.head.load(std::memory_order_acquire) - consumer_.tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return num_slots_; }
+    size_t slotWords() const { return slot_words_; }
+
+    // Events dropped because the ring was full or dropEvent() was called, and those too big for a slot
+    uint32_t getNumOverflows() const { return num_overflows_.load(std::memory_order_relaxed); }
+    uint32_t getNumOversized() const { return num_oversized_.load(std::memory_order_relaxed); }
+
+    // Write the dropped event count, full ring and oversized, into the readout monitor
+    void publish(TpcReadoutMonitor& monitor) const { monitor.setNumRwBufferOverflow(getNumOverflows() + getNumOversized()); }
+
+private:
+    static size_t roundUpPow2(size_t n) {
+        size_t pow2 = 1;
+        while (pow2 < n) pow2 *= 2;
+        return pow2;
+    }
+
+    uint32_t* slotData(size_t index) { return slots_.data() + (index & mask_) * slot_words_; }
+
+    bool fail(bool oversized) {
+        // Only the producer writes the counters, so a load and store is enough
+        auto& counter = oversized ? num_oversized_ : num_overflows_;
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    struct alignas(kCacheLineSize) ProducerIndex {
+        std::atomic<size_t> head{0};
+        size_t cached_tail = 0;
+    };
+    struct alignas(kCacheLineSize) ConsumerIndex {
+        std::atomic<size_t> tail{0};
+        size_t cached_head = 0;
+    };
+
+    const size_t num_slots_;
+    const size_t mask_;
+    const size_t slot_words_;
+    CacheAlignedVector<uint32_t> slots_;
+    std::vector<size_t> sizes_;
+
+    ProducerIndex producer_;
+    ConsumerIndex consumer_;
+    alignas(kCacheLineSize) std::atomic<uint32_t> num_overflows_{0};
+    std::atomic<uint32_t> num_oversized_{0};
+};
+
+#endif //EVENT_RING_H
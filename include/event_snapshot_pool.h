@@ -0,0 +1,165 @@
+//
+// Preallocated charge/light event snapshots, so building a detector snapshot never allocates.
+//
+
+#ifndef EVENT_SNAPSHOT_POOL_H
+#define EVENT_SNAPSHOT_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "tpc_monitor_charge_event.h"
+#include "tpc_monitor_light_event.h"
+
+// Samples per channel a pooled snapshot is sized for by default
+template <typename Event>
+struct SnapshotSamples;
+template <>
+struct SnapshotSamples<TpcMonitorChargeEvent> {
+    static constexpr size_t value = CHARGE_ONE_FRAME;
+};
+template <>
+struct SnapshotSamples<TpcMonitorLightEvent> {
+    static constexpr size_t value = NUM_LIGHT_SAMPLES;
+};
+
+// Events in a pool by default, one per channel for a full snapshot
+template <typename Event>
+struct SnapshotChannels;
+template <>
+struct SnapshotChannels<TpcMonitorChargeEvent> {
+    static constexpr size_t value = NUM_CHARGE_CHANNELS;
+};
+template <>
+struct SnapshotChannels<TpcMonitorLightEvent> {
+    static constexpr size_t value = NUM_LIGHT_CHANNELS;
+};
+
+/**
+ * A fixed set of TpcMonitorChargeEvent or TpcMonitorLightEvent objects handed out through
+ * handles which put them back when released.
+ *
+ * Every event's payload is reserved up front for max_samples samples in the largest packing, so
+ * setting samples up to that size, serializing into a reserved buffer or deserializing reuses
+ * the storage. Released events are cleared but keep their capacity. When the pool is empty,
+ * acquire() returns an empty handle rather than allocating. The pool must outlive its handles.
+ */
+template <typename Event>
+class EventSnapshotPool {
+public:
+    // Owns one pooled event until destroyed or released, move-only
+    class Handle {
+    public:
+        Handle() = default;
+        Handle(Handle&& other) noexcept : pool_(other.pool_), event_(other.event_) {
+            other.pool_ = nullptr;
+            other.event_ = nullptr;
+        }
+        Handle& operator=(Handle&& other) noexcept {
+            if (this != &other) {
+                release();
+                std::swap(pool_, other.pool_);
+                std::swap(event_, other.event_);
+            }
+            return *this;
+        }
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+        ~Handle() { release(); }
+
+        explicit operator bool() const { return event_ != nullptr; }
+        Event* get() const { return event_; }
+        Event& operator*() const { return *event_; }
+        Event* operator->() const { return event_; }
+
+        // Return the event to the pool early
+        void release() {
+            if (event_ != nullptr) pool_->recycle(event_);
+            pool_ = nullptr;
+            event_ = nullptr;
+        }
+
+    private:
+        friend class EventSnapshotPool;
+        Handle(EventSnapshotPool* pool, Event* event) : pool_(pool), event_(event) {}
+
+        EventSnapshotPool* pool_ = nullptr;
+        Event* event_ = nullptr;
+    };
+
+    /**
+     * @param num_events Events in the pool, by default one per channel for a full snapshot.
+     * @param max_samples Samples per event the payload storage is reserved for.
+     */
+    explicit EventSnapshotPool(size_t num_events = SnapshotChannels<Event>::value,
+                               size_t max_samples = SnapshotSamples<Event>::value)
+        : events_(num_events), capacity_words_(maxPackedWords(max_samples)) {
+        free_.reserve(num_events);
+        for (Event& event : events_) {
+            event.reserveSamples(capacity_words_);
+            free_.push_back(&event);
+        }
+    }
+    EventSnapshotPool(const EventSnapshotPool&) = delete;
+    EventSnapshotPool& operator=(const EventSnapshotPool&) = delete;
+
+    /**
+     * @brief A cleared event, or an empty handle if every event is in use.
+     * @throws std::logic_error if the event would serialize more than its header, i.e. a payload
+     * was left behind by the previous user.
+     */
+    Handle acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            num_exhausted_.fetch_add(1, std::memory_order_relaxed);
+            return Handle();
+        }
+        Event* event = free_.back();
+        if (event->getNumWords() != Event::kHeaderWords) {
+            throw std::logic_error("EventSnapshotPool event serializes to " + std::to_string(event->getNumWords()) +
+                                   " words before its samples are set, expected " +
+                                   std::to_string(Event::kHeaderWords));
+        }
+        free_.pop_back();
+        return Handle(this, event);
+    }
+
+    size_t size() const { return events_.size(); }
+    size_t available() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return free_.size();
+    }
+    // Payload words reserved per event
+    size_t capacityWords() const { return capacity_words_; }
+    // Times acquire() found the pool empty
+    uint64_t getNumExhausted() const { return num_exhausted_.load(std::memory_order_relaxed); }
+
+private:
+    // The Rice bound is the largest of the packings, pack() fills up to it before trimming
+    static size_t maxPackedWords(size_t num_samples) {
+        return std::max({sample_packing::packedWords(SamplePacking::k16Bit, num_samples),
+                         sample_packing::packedWords(SamplePacking::k12Bit, num_samples),
+                         sample_packing::packedWords(SamplePacking::kRice, num_samples)});
+    }
+
+    void recycle(Event* event) {
+        event->clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(event);
+    }
+
+    std::vector<Event> events_;
+    const size_t capacity_words_;
+    mutable std::mutex mutex_;
+    // Never grows past events_.size(), so pushing back does not allocate
+    std::vector<Event*> free_;
+    std::atomic<uint64_t> num_exhausted_{0};
+};
+
+using ChargeEventPool = EventSnapshotPool<TpcMonitorChargeEvent>;
+using LightEventPool = EventSnapshotPool<TpcMonitorLightEvent>;
+
+#endif //EVENT_SNAPSHOT_POOL_H
@@ -6,9 +6,64 @@
 #define HISTOGRAM_H
 
 #include "metric_base.h"
+#include "cache_aligned.h"
 
 using namespace constants::tpc_readout;
 
+/**
+ * Integer bin lookup for a histogram with num_bins equal bins over [min, max).
+ *
+ * The bin of a value is floor((value - min) * num_bins / (max - min)), evaluated after reducing
+ * the fraction as a single multiply and shift, (value - min) * multiplier >> shift. The multiplier
+ * is a fixed-point reciprocal of the reduced range, or just the reduced bin count when the reduced
+ * range is a power of two. The constructor verifies the result is exact over the whole range and
+ * otherwise falls back to a 64-bit division.
+ */
+class BinIndexer {
+public:
+    BinIndexer() : BinIndexer(0, 1, 1) {}
+    BinIndexer(uint32_t min_value, uint32_t max_value, uint32_t num_bins);
+
+    // Bin of a value in [min, max), the caller handles values outside the range
+    uint32_t index(uint32_t value) const {
+        const uint64_t offset = value - min_value_;
+        if (divide_) return static_cast<uint32_t>(offset * numerator_ / denominator_);
+        return static_cast<uint32_t>((offset * multiplier_) >> shift_);
+    }
+
+    /**
+     * @brief Map a batch of values to histogram slots, vectorized with AVX2 when available.
+     * @details Slots 0 to num_bins-1 are the bins, num_bins is below and num_bins+1 above the range.
+     * @param values The values to bin.
+     * @param num_values Number of values.
+     * @param slots Output, one slot per value.
+     */
+    void slots(const uint32_t* values, size_t num_values, uint32_t* slots) const;
+
+    /**
+     * @brief Slots of values packed two per word as by PackDoubleWords(), lower half first.
+     * @details Writes 2 * num_words slots. The order of the slots within the output is not
+     * the sample order, which does not matter for counting.
+     */
+    void packedSlots(const uint32_t* words, size_t num_words, uint32_t* slots) const;
+
+    uint32_t getMinValue() const { return min_value_; }
+    uint32_t getNumBins() const { return num_bins_; }
+    uint64_t getMultiplier() const { return multiplier_; }
+    uint32_t getShift() const { return shift_; }
+    bool usesDivision() const { return divide_; }
+
+private:
+    uint32_t min_value_;
+    uint32_t range_;
+    uint32_t num_bins_;
+    uint64_t numerator_;
+    uint64_t denominator_;
+    uint64_t multiplier_;
+    uint32_t shift_;
+    bool divide_;
+};
+
 class Histogram : public MetricBase {
 private:
     // Configuration
@@ -16,6 +71,7 @@ private:
     uint32_t max_value;
     uint32_t num_bins;
     double bin_width;
+    BinIndexer indexer;
 
     // Data storage
     std::vector<uint32_t> bins;
@@ -23,7 +79,7 @@ private:
     uint32_t above_range_count;
 
     // Implement  the serialize/deserialize
-    size_t num_members_ = 5;
+    static constexpr size_t num_members_ = 5;
     auto member_tuple() {
         return std::tie(min_value, max_value, num_bins, below_range_count, above_range_count);
     };
@@ -38,7 +94,35 @@ public:
     Histogram(uint32_t min, uint32_t max, uint32_t bins_count);
 
     // Public API
-    void fill(uint32_t value);
+    void fill(uint32_t value) {
+        if (value < min_value) {
+            below_range_count++;
+        } else if (value >= max_value) {
+            above_range_count++;
+        } else {
+            bins[indexer.index(value)]++;
+        }
+    }
+    /**
+     * @brief Fill a whole waveform in one call.
+     * @details Bin indices are computed a block at a time with SIMD and counted into interleaved
+     * sub-histograms, so consecutive samples in the same bin don't serialize on one counter.
+     */
+    void fill(const uint32_t* values, size_t num_values);
+    void fill(const std::vector<uint32_t>& values) { fill(values.data(), values.size()); }
+    /**
+     * @brief Fill straight from samples packed two per 32-bit word, sample i in the lower and
+     * i+1 in the upper 16 bits, as written by PackDoubleWords().
+     * @param words The packed words, (num_samples + 1) / 2 of them.
+     * @param num_samples Number of samples, an odd count ignores the last upper half.
+     */
+    void fillPacked(const uint32_t* words, size_t num_samples);
+    /**
+     * @brief Add the counts of another histogram, e.g. one filled by another thread.
+     * @throws std::invalid_argument if the range or number of bins differ.
+     */
+    void merge(const Histogram& other);
+    Histogram& operator+=(const Histogram& other) { merge(other); return *this; }
     void clear();
     void print() const;
 
@@ -51,9 +135,9 @@ public:
     uint32_t getAboveRangeCount() const { return above_range_count; }
 
     // MetricBase interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 
 #ifdef USE_PYTHON
     py::dict getMetricDict() override;
@@ -61,4 +145,123 @@ public:
 
 };
 
+class HistogramView;
+
+/**
+ * Equal-binned histograms for a set of channels, stored channels x bins in one cache line aligned
+ * buffer. Every channel row is padded to whole cache lines and the below and above range counters
+ * of all channels follow the rows, so clear() is a single memset and no channel shares a line
+ * with another. All channels share one binning.
+ *
+ * The serialized form is that of one Histogram per channel, back to back.
+ */
+class HistogramBlock {
+public:
+    HistogramBlock() : HistogramBlock(0, 0, 1, 1) {}
+    HistogramBlock(size_t num_channels, uint32_t min, uint32_t max, uint32_t bins_count);
+
+    void fill(size_t channel, uint32_t value) {
+        checkChannel(channel);
+        if (value < min_value_) {
+            belowCounts()[channel]++;
+        } else if (value >= max_value_) {
+            aboveCounts()[channel]++;
+        } else {
+            row(channel)[indexer_.index(value)]++;
+        }
+    }
+    // Whole waveforms, see Histogram::fill(const uint32_t*, size_t) and Histogram::fillPacked()
+    void fill(size_t channel, const uint32_t* values, size_t num_values);
+    void fillPacked(size_t channel, const uint32_t* words, size_t num_samples);
+    // Add the counts of a block with the same channels and binning, throws std::invalid_argument otherwise
+    void merge(const HistogramBlock& other);
+    bool isMergeable(const HistogramBlock& other) const {
+        return num_channels_ == other.num_channels_ && min_value_ == other.min_value_ &&
+               max_value_ == other.max_value_ && num_bins_ == other.num_bins_;
+    }
+    HistogramBlock& operator+=(const HistogramBlock& other) { merge(other); return *this; }
+    void clear();
+
+    size_t getNumChannels() const { return num_channels_; }
+    uint32_t getMinValue() const { return min_value_; }
+    uint32_t getMaxValue() const { return max_value_; }
+    uint32_t getNumBins() const { return num_bins_; }
+    // Words between the starts of consecutive channel rows
+    size_t getRowStride() const { return row_stride_; }
+    const uint32_t* getBins(size_t channel) const { checkChannel(channel); return row(channel); }
+    uint32_t getBelowRangeCount(size_t channel) const { checkChannel(channel); return belowCounts()[channel]; }
+    uint32_t getAboveRangeCount(size_t channel) const { checkChannel(channel); return aboveCounts()[channel]; }
+    // Number of values filled into a channel, in and out of range
+    uint64_t getEntries(size_t channel) const;
+    HistogramView view(size_t channel) const;
+    std::vector<HistogramView> views() const;
+
+    // Number of words serialize_into() appends
+    size_t serializedWords() const { return num_channels_ * (kHeaderWords + num_bins_); }
+    void serialize_into(std::vector<uint32_t>& out) const;
+    /**
+     * @brief Read num_channels serialized histograms.
+     * @details The binning of the first histogram is adopted by the block.
+     * @throws std::runtime_error if the data is short or the channels do not share one binning.
+     */
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end);
+
+private:
+    // Histogram metadata words on the wire, min, max, num_bins, below and above range counts
+    static constexpr size_t kHeaderWords = 5;
+
+    void configure(uint32_t min, uint32_t max, uint32_t bins_count);
+    void checkChannel(size_t channel) const {
+        if (channel >= num_channels_) {
+            throw std::out_of_range("HistogramBlock channel [" + std::to_string(channel) + "] out of range [" +
+                                    std::to_string(num_channels_) + "]");
+        }
+    }
+    uint32_t* row(size_t channel) { return storage_.data() + channel * row_stride_; }
+    const uint32_t* row(size_t channel) const { return storage_.data() + channel * row_stride_; }
+    uint32_t* belowCounts() { return row(num_channels_); }
+    const uint32_t* belowCounts() const { return row(num_channels_); }
+    uint32_t* aboveCounts() { return belowCounts() + counter_stride_; }
+    const uint32_t* aboveCounts() const { return belowCounts() + counter_stride_; }
+
+    size_t num_channels_;
+    uint32_t min_value_;
+    uint32_t max_value_;
+    uint32_t num_bins_;
+    size_t row_stride_;
+    BinIndexer indexer_;
+
+    // Channel rows, then the below and then the above range counters, each padded to cache lines
+    CacheAlignedVector<uint32_t> storage_;
+    size_t counter_stride_;
+};
+
+/**
+ * Read-only view of one channel of a HistogramBlock, valid as long as the block is alive and not
+ * reconfigured by a deserialize.
+ */
+class HistogramView {
+public:
+    HistogramView(const HistogramBlock& block, size_t channel) : block_(&block), channel_(channel) {}
+
+    uint32_t getMinValue() const { return block_->getMinValue(); }
+    uint32_t getMaxValue() const { return block_->getMaxValue(); }
+    uint32_t getNumBins() const { return block_->getNumBins(); }
+    const uint32_t* getBins() const { return block_->getBins(channel_); }
+    uint32_t getBin(size_t bin) const { return getBins()[bin]; }
+    uint32_t getBelowRangeCount() const { return block_->getBelowRangeCount(channel_); }
+    uint32_t getAboveRangeCount() const { return block_->getAboveRangeCount(channel_); }
+
+    // Standalone copy of the channel
+    Histogram toHistogram() const;
+    void print() const { toHistogram().print(); }
+#ifdef USE_PYTHON
+    py::dict getMetricDict() const;
+#endif
+
+private:
+    const HistogramBlock* block_;
+    size_t channel_;
+};
+
 #endif //HISTOGRAM_H
@@ -0,0 +1,102 @@
+//
+// Per-channel baseline, RMS and hit counts computed from full events for the LowBwTpcMonitor.
+//
+
+#ifndef LBW_STATS_ENGINE_H
+#define LBW_STATS_ENGINE_H
+
+#include <vector>
+#include "tpc_monitor_lbw.h"
+
+// Thresholds and clipping of the waveform analysis, thresholds are ADC counts from the baseline
+struct LbwStatsConfig {
+    uint32_t charge_hit_threshold = 20;
+    uint32_t light_roi_threshold = 50;
+    // Samples further than clip_sigma * RMS from the baseline are dropped for the next iteration
+    double clip_sigma = 3.0;
+    uint32_t clip_iterations = 3;
+};
+
+// Result of analyzing one waveform
+struct WaveformStats {
+    double baseline = 0.0;
+    double rms = 0.0;
+    // Excursions beyond the threshold, a run of consecutive samples counts once
+    uint32_t num_hits = 0;
+};
+
+/**
+ * Computes the per-channel summaries of the LowBwTpcMonitor from full charge and light events.
+ *
+ * Each waveform gets a robust baseline and RMS from an iteratively sigma-clipped mean, so pulses
+ * do not pull it, and its hits (charge) or ROIs (light) counted as excursions beyond a threshold
+ * on either side of the baseline. The kernels run on AVX2 when the CPU supports it. Results are
+ * averaged over the events added since the last clear() and published in the 16-bit fields of
+ * the monitor, the RMS and average counts scaled by kScale.
+ */
+class LbwStatsEngine {
+public:
+    // Fixed-point scale of the published RMS and average hit/ROI counts
+    static constexpr double kScale = 100.0;
+
+    explicit LbwStatsEngine(const LbwStatsConfig& config = LbwStatsConfig());
+
+    /**
+     * @brief Add one event of NUM_CHARGE_CHANNELS waveforms stored one after the other.
+     * @param samples The waveforms, num_samples each.
+     * @param num_samples Samples per waveform, NUM_CHARGE_SAMPLES for a full event.
+     */
+    void addChargeEvent(const uint32_t* samples, size_t num_samples);
+    void addLightEvent(const uint32_t* samples, size_t num_samples);
+    // Samples packed two per word, each waveform starting on a word boundary as in TpcMonitor::fillEventPacked()
+    void addChargeEventPacked(const uint32_t* words, size_t num_samples);
+    void addLightEventPacked(const uint32_t* words, size_t num_samples);
+
+    /**
+     * @brief Add the packed waveform of a single channel, for events arriving channel by channel.
+     * @details The event only counts towards the averages once finishChargeEvent() or
+     * finishLightEvent() is called, so every channel should be added exactly once before that.
+     * Different channels may be added from different threads at the same time.
+     */
+    void addChargeChannelPacked(size_t channel, const uint32_t* words, size_t num_samples);
+    void addLightChannelPacked(size_t channel, const uint32_t* words, size_t num_samples);
+    void finishChargeEvent() { num_charge_events_++; }
+    void finishLightEvent() { num_light_events_++; }
+
+    // Write the averages into the monitor's charge and light channel fields
+    void publish(LowBwTpcMonitor& monitor) const;
+    void clear();
+
+    const LbwStatsConfig& getConfig() const { return config_; }
+    uint32_t getNumChargeEvents() const { return num_charge_events_; }
+    uint32_t getNumLightEvents() const { return num_light_events_; }
+    // Averages over the added events of one channel
+    WaveformStats getChargeChannel(size_t channel) const;
+    WaveformStats getLightChannel(size_t channel) const;
+
+    /**
+     * @brief Baseline, RMS and number of excursions of a single waveform.
+     * @details Samples are 12-bit ADC words, anything at or above 2^16 is treated as an outlier.
+     */
+    static WaveformStats analyzeWaveform(const uint32_t* samples, size_t num_samples, uint32_t threshold,
+                                         double clip_sigma, uint32_t clip_iterations);
+
+private:
+    // Sums of the per-event results of one channel
+    struct ChannelSums {
+        double baseline = 0.0;
+        double rms = 0.0;
+        uint64_t num_hits = 0;
+    };
+
+    void addWaveform(ChannelSums& sums, const uint32_t* samples, size_t num_samples, uint32_t threshold) const;
+    static WaveformStats average(const ChannelSums& sums, uint32_t num_events);
+
+    LbwStatsConfig config_;
+    std::vector<ChannelSums> charge_sums_;
+    std::vector<ChannelSums> light_sums_;
+    uint32_t num_charge_events_ = 0;
+    uint32_t num_light_events_ = 0;
+};
+
+#endif //LBW_STATS_ENGINE_H
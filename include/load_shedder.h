@@ -0,0 +1,80 @@
+//
+// Graceful degradation of the monitor pipeline when events arrive faster than it keeps up.
+//
+
+#ifndef LOAD_SHEDDER_H
+#define LOAD_SHEDDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "tpc_monitor_lbw.h"
+
+// How much monitoring work is done per event, each level cheaper than the one before
+enum class ShedLevel : uint8_t {
+    kFull = 0,           // histograms, LBW statistics and snapshots
+    kHistogramOnly = 1,  // histograms only
+    kSampled = 2         // histograms of one event in sample_interval, the others skipped
+};
+
+/**
+ * Watermarks on the depth of the event queue feeding the monitor, e.g. EventRing::size().
+ * A level is entered once the depth reaches its high watermark and left once the depth drops
+ * to its low watermark, the gap keeps the level from flapping around a single threshold.
+ */
+struct LoadSheddingConfig {
+    size_t histogram_only_high = 8;
+    size_t histogram_only_low = 2;
+    size_t sampled_high = 32;
+    size_t sampled_low = 16;
+    // Under kSampled one event in sample_interval is histogrammed
+    uint32_t sample_interval = 10;
+};
+
+/**
+ * Picks the monitoring level from the queue depth and decides per event how much work to do.
+ *
+ * The consumer reports the queue depth with update() before each event and asks admit() for the
+ * event's action. Events processed (fully or histogram only) and skipped are counted for the
+ * LowBwTpcMonitor. Used from the consumer thread only.
+ */
+class LoadShedder {
+public:
+    enum class Action : uint8_t {
+        kFull,
+        kHistogramOnly,
+        kSkip
+    };
+
+    // Throws std::invalid_argument unless each low watermark is below its high one and the
+    // histogram-only watermarks are below the sampled ones
+    explicit LoadShedder(const LoadSheddingConfig& config = LoadSheddingConfig());
+
+    // Move between levels for the current queue depth
+    void update(size_t queue_depth);
+    // Action for the next event at the current level
+    Action admit();
+
+    // Write the processed and skipped event counts into the monitor
+    void publish(LowBwTpcMonitor& monitor) const;
+    void resetCounters();
+
+    const LoadSheddingConfig& getConfig() const { return config_; }
+    ShedLevel getLevel() const { return level_; }
+    uint32_t getNumProcessed() const { return num_processed_; }
+    uint32_t getNumHistogramOnly() const { return num_histogram_only_; }
+    uint32_t getNumSkipped() const { return num_skipped_; }
+    // Level changes since the last resetCounters()
+    uint32_t getNumLevelChanges() const { return num_level_changes_; }
+
+private:
+    LoadSheddingConfig config_;
+    ShedLevel level_ = ShedLevel::kFull;
+    // Events since the last sampled one
+    uint32_t since_sample_ = 0;
+    uint32_t num_processed_ = 0;
+    uint32_t num_histogram_only_ = 0;
+    uint32_t num_skipped_ = 0;
+    uint32_t num_level_changes_ = 0;
+};
+
+#endif //LOAD_SHEDDER_H
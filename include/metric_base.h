@@ -6,13 +6,20 @@
 #define METRIC_BASE_H
 
 #include <iostream>
+#include <array>
 #include <vector>
 #include <cstdint>
 #include <climits>
+#include <cstring>
 #include <tuple>
+#include <utility>
 #include <stdexcept>
+#include <string>
+#include <algorithm>
 #include "CommunicationCodes.hh"
 #include "constants.h"
+#include "crc32c.h"
+#include "sample_packing.h"
 
 #ifdef USE_PYTHON
     #include <pybind11/pybind11.h>
@@ -35,11 +42,34 @@ public:
     // Virtual destructor is essential for a polymorphic base class.
     virtual ~MetricBase() = default;
 
+    /**
+     * @brief Appends the object's serialized state to the end of an output buffer.
+     * @details Nothing already in the buffer is touched. Clearing and reusing the same buffer
+     * between snapshots means no heap allocation once it has grown to the snapshot size.
+     * @param out The buffer the serialized words are appended to.
+     */
+    virtual void serialize_into(std::vector<uint32_t>& out) const = 0;
+
     /**
      * @brief Serializes the object's state into a vector of 32-bit integers.
+     * @details Convenience wrapper around serialize_into() with a fresh buffer.
      * @return A vector containing the serialized data.
      */
-    virtual std::vector<uint32_t> serialize() const = 0;
+    std::vector<uint32_t> serialize() const {
+        std::vector<uint32_t> serialized_data;
+        serialize_into(serialized_data);
+        return serialized_data;
+    }
+
+    /**
+     * @brief Deserializes data straight out of a caller-owned buffer and populates the object.
+     * @details The words are read in place, so a received packet or a mmap'd file can be
+     * decoded without first copying it into a std::vector.
+     * @param begin Pointer to the first word of the data range.
+     * @param end Pointer one past the last word of the data range.
+     * @return A pointer to the position after the last consumed word.
+     */
+    virtual const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) = 0;
 
     /**
      * @brief Deserializes data from an iterator and populates the object.
@@ -47,8 +77,23 @@ public:
      * @param end A const iterator to the end of the data range.
      * @return An iterator pointing to the position after the last consumed element.
      */
-    virtual std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                             std::vector<uint32_t>::const_iterator end) = 0;
+    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
+                                                      std::vector<uint32_t>::const_iterator end) {
+        // Vector storage is contiguous so decode the range in place
+        const auto size = std::distance(begin, end);
+        const uint32_t* first = size > 0 ? &*begin : nullptr;
+        return begin + (deserialize(first, first + size) - first);
+    }
+
+    /**
+     * @brief Deserializes data from a pointer and a number of words.
+     * @param data Pointer to the first word of the data.
+     * @param num_words Number of 32-bit words available at data.
+     * @return A pointer to the position after the last consumed word.
+     */
+    const uint32_t* deserialize(const uint32_t* data, size_t num_words) {
+        return deserialize(data, data + num_words);
+    }
 
     /**
      * @brief Deserializes the object from a complete vector of data.
@@ -60,6 +105,65 @@ public:
         deserialize(data.begin(), data.end());
     }
 
+    /**
+     * @brief Appends the serialized state followed by a CRC32C trailer word.
+     * @details The checksum covers only the words written by this call, so the buffer may
+     * already hold other data. The hardware CRC runs at about 8 bytes a cycle, the limit of the
+     * crc32 instruction, while serializing a histogram metric is little more than a copy, so the
+     * trailer adds a third or more to a TpcMonitor serialize rather than a few percent. See
+     * bench/bench_crc32c.cpp.
+     * @param out The buffer the serialized words and trailer are appended to.
+     */
+    void serialize_into_with_crc(std::vector<uint32_t>& out) const {
+        const size_t start = out.size();
+        serialize_into(out);
+        out.push_back(crc32c::compute(out.data() + start, out.data() + out.size()));
+    }
+
+    std::vector<uint32_t> serialize_with_crc() const {
+        std::vector<uint32_t> serialized_data;
+        serialize_into_with_crc(serialized_data);
+        return serialized_data;
+    }
+
+    /**
+     * @brief Deserializes data written by serialize_into_with_crc() and verifies the trailer.
+     * @details The payload length is only known once it is decoded, so on a mismatch the object
+     * may already hold the corrupt values and must be discarded.
+     * @return A pointer to the position after the trailer.
+     * @throws std::runtime_error if the trailer is missing or does not match.
+     */
+    const uint32_t* deserialize_with_crc(const uint32_t* begin, const uint32_t* end) {
+        const uint32_t* payload_end = deserialize(begin, end);
+        requireWords(payload_end, end, 1, "CRC32C trailer");
+        verifyCrc(begin, payload_end, *payload_end);
+        return payload_end + 1;
+    }
+
+    /**
+     * @brief Verifies the trailer of a complete buffer before deserializing it.
+     * @details The object is left untouched if the checksum does not match.
+     * @throws std::runtime_error if the trailer does not match or the payload is not fully consumed.
+     */
+    void deserialize_with_crc(const std::vector<uint32_t>& data) {
+        requireWords(data.begin(), data.end(), 1, "CRC32C trailer");
+        const uint32_t* begin = data.data();
+        const uint32_t* payload_end = begin + data.size() - 1;
+        verifyCrc(begin, payload_end, *payload_end);
+        if (deserialize(begin, payload_end) != payload_end) {
+            throw std::runtime_error("Deserialization failed: payload length does not match the CRC32C trailer position");
+        }
+    }
+
+    // Throws if the CRC32C of [begin, end) differs from the expected trailer
+    static void verifyCrc(const uint32_t* begin, const uint32_t* end, uint32_t expected) {
+        const uint32_t computed = crc32c::compute(begin, end);
+        if (computed != expected) {
+            throw std::runtime_error("Deserialization failed: CRC32C mismatch, computed [" + std::to_string(computed) +
+                                     "] but trailer holds [" + std::to_string(expected) + "]");
+        }
+    }
+
     /**
      * Helper functions to set and access bits in bit words
      */
@@ -93,14 +197,20 @@ public:
      */
     template <typename T>
     struct Serializer {
+        // Append tuple of ints to the end of a vector
+        template <typename... Args>
+        static void serialize_tuple_into(const std::tuple<Args...>& t, std::vector<uint32_t>& out) {
+            std::apply([&](const auto&... elems) {
+                ((out.push_back(static_cast<uint32_t>(elems))), ...);
+            }, t);
+        }
+
         // Convert tuple of ints to vector
         template <typename... Args>
         static std::vector<uint32_t> serialize_tuple(const std::tuple<Args...> t) {
             std::vector<uint32_t> result;
             result.reserve(sizeof...(Args));
-            std::apply([&](const auto&... elems) {
-                ((result.push_back(static_cast<uint32_t>(elems))), ...);
-            }, t);
+            serialize_tuple_into(t, result);
             return result;
         }
 
@@ -111,16 +221,130 @@ public:
             if (size < static_cast<decltype(size)>(sizeof...(Args)))
                 throw std::runtime_error("Not enough data to deserialize tuple");
 
+            return unpack_tuple(t, it);
+        }
+
+        // Write tuple of ints to an output iterator, the caller guarantees the space
+        template <typename... Args, typename OutIter>
+        static OutIter pack_tuple(const std::tuple<Args...>& t, OutIter out) {
+            std::apply([&](const auto&... elems) {
+                ((*out++ = static_cast<uint32_t>(elems)), ...);
+            }, t);
+            return out;
+        }
+
+        // Read tuple from an iterator, the caller guarantees the data has already been bounds checked
+        template <typename... Args, typename Iter>
+        static Iter unpack_tuple(std::tuple<Args...> t, Iter it) {
             std::apply([&](auto&... elems) {
                 ((elems = *it++), ...);
             }, t);
+            return it;
+        }
 
+        // Copy fixed-size arrays back to back to an output iterator
+        template <typename OutIter, typename... Arrays>
+        static OutIter pack_arrays(OutIter out, const Arrays&... arrays) {
+            ((out = std::copy(arrays.begin(), arrays.end(), out)), ...);
+            return out;
+        }
+
+        // Fill fixed-size arrays back to back from an iterator, the caller guarantees the data is long enough
+        template <typename Iter, typename... Arrays>
+        static Iter unpack_arrays(Iter it, Arrays&... arrays) {
+            ((std::copy(it, it + arrays.size(), arrays.begin()), it += arrays.size()), ...);
             return it;
         }
     };
 
+    /**
+     * Compile-time wire layout of a fixed-size metric.
+     * @tparam FieldWords Number of 32-bit words in each field group, in serialization order.
+     */
+    template <size_t... FieldWords>
+    struct WireLayout {
+        static constexpr size_t kNumFields = sizeof...(FieldWords);
+        static constexpr std::array<size_t, kNumFields> kFieldWords{FieldWords...};
+        static constexpr size_t kWireWords = (FieldWords + ... + 0);
+
+        // Word offset of a field group from the start of the serialized metric
+        static constexpr size_t offset(size_t field) {
+            size_t words = 0;
+            for (size_t i = 0; i < field && i < kNumFields; i++) words += kFieldWords[i];
+            return words;
+        }
+
+        // True if the member tuple/std::array types have exactly the word counts of the layout
+        template <typename... Fields>
+        static constexpr bool matches() {
+            if constexpr (sizeof...(Fields) != kNumFields) {
+                return false;
+            } else {
+                constexpr std::array<size_t, kNumFields> sizes{std::tuple_size_v<std::decay_t<Fields>>...};
+                for (size_t i = 0; i < kNumFields; i++) {
+                    if (sizes[i] != kFieldWords[i]) return false;
+                }
+                return true;
+            }
+        }
+    };
+
+    /**
+     * @brief Single bounds check for a fixed-size metric before it is decoded.
+     * @throws std::runtime_error if fewer than num_words are available.
+     */
+    template <typename Iter>
+    static void requireWords(Iter begin, Iter end, size_t num_words, const char* metric_name) {
+        const auto available = static_cast<size_t>(std::distance(begin, end));
+        if (available < num_words) {
+            throw std::runtime_error(std::string("Deserialization failed: ") + metric_name + " words received [" +
+                std::to_string(available) + "] but requires [" + std::to_string(num_words) + "]");
+        }
+    }
+
 // Python binding functions
 #ifdef USE_PYTHON
+    /**
+     * @brief View a python buffer (bytes, memoryview, numpy) as 32-bit words without copying.
+     * @details The buffer must be C-contiguous and hold either 32-bit words or raw bytes whose
+     * length is a multiple of 4. Only a buffer which does not start on a word boundary is copied,
+     * into aligned_copy, which must then outlive the returned pointer as must info.
+     * @return Pointer to the first word and the number of words.
+     */
+    static std::pair<const uint32_t*, size_t> bufferWords(const py::buffer_info& info,
+                                                          std::vector<uint32_t>& aligned_copy) {
+        if (info.ndim != 1 || info.strides[0] != info.itemsize) {
+            throw std::runtime_error("Deserialization failed: buffer must be 1D and C-contiguous.");
+        }
+        const size_t num_bytes = static_cast<size_t>(info.size) * info.itemsize;
+        if (info.itemsize != sizeof(uint32_t) && info.itemsize != 1) {
+            throw std::runtime_error("Deserialization failed: buffer items must be 32-bit words or bytes.");
+        }
+        if (num_bytes % sizeof(uint32_t) != 0) {
+            throw std::runtime_error("Deserialization failed: buffer size is not a multiple of 4 bytes.");
+        }
+        const size_t num_words = num_bytes / sizeof(uint32_t);
+        if (reinterpret_cast<uintptr_t>(info.ptr) % alignof(uint32_t) != 0) {
+            // A sliced memoryview can start mid-word, only then do we pay for an aligned copy
+            aligned_copy.resize(num_words);
+            std::memcpy(aligned_copy.data(), info.ptr, num_bytes);
+            return {aligned_copy.data(), num_words};
+        }
+        return {static_cast<const uint32_t*>(info.ptr), num_words};
+    }
+
+    /**
+     * @brief Deserialize directly from any object exposing the buffer protocol (bytes, memoryview, numpy).
+     * @param buffer The python buffer holding the serialized words, see bufferWords().
+     * @return The number of 32-bit words consumed.
+     */
+    size_t deserializeBuffer(const py::buffer& buffer) {
+        py::buffer_info info = buffer.request();
+        std::vector<uint32_t> aligned_copy;
+        auto [begin, num_words] = bufferWords(info, aligned_copy);
+        return deserialize(begin, begin + num_words) - begin;
+    }
+
     /**
     * @brief Get a map of the metrics with a key giving the name and value giving the metric
     * @return The std::map is converted to a python dictionary holding the metrics
@@ -147,6 +371,19 @@ public:
     py::array_t<T> array_to_numpy_array_1d(const std::array<T, N>& arr) {
         return py::array_t<T>({N}, arr.data());
     }
+
+    /**
+     * Unpack packed sample words straight into a new numpy array, without an intermediate vector.
+     * @param packing How the samples are packed
+     * @param words The packed words
+     * @param num_words Number of packed words
+     * @return The unpacked samples as a numpy array
+     */
+    static py::array_t<uint32_t> packed_to_numpy_array_1d(SamplePacking packing, const uint32_t* words, size_t num_words) {
+        py::array_t<uint32_t> samples(sample_packing::numSamples(packing, words, num_words));
+        sample_packing::unpack(packing, words, num_words, samples.mutable_data());
+        return samples;
+    }
 #endif
 
 };
@@ -0,0 +1,65 @@
+//
+// Reduction of metrics filled in parallel, e.g. one TpcMonitor per worker thread.
+//
+
+#ifndef METRIC_MERGE_H
+#define METRIC_MERGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace metric_merge {
+
+    /**
+     * @brief Pairwise tree reduction of metrics supporting operator+=, the total ends up in parts[0].
+     * @details Level by level, parts[i] += parts[i + stride] with the stride doubling each level,
+     * so N parts take ceil(log2 N) levels. The merges within a level are independent and are
+     * spread over up to num_threads threads; the other parts are left holding partial sums.
+     * @param parts The metrics to reduce, merged in place.
+     * @param num_threads Threads per level, 1 merges on the calling thread.
+     * @throws The first exception thrown by a merge, e.g. std::invalid_argument for mismatched binnings.
+     */
+    template <typename Metric>
+    void reduceTree(std::vector<Metric>& parts, size_t num_threads = 1) {
+        const size_t num_parts = parts.size();
+        for (size_t stride = 1; stride < num_parts; stride *= 2) {
+            const size_t num_pairs = (num_parts - stride + 2 * stride - 1) / (2 * stride);
+            const size_t num_workers = std::min(std::max<size_t>(num_threads, 1), num_pairs);
+            // Worker w merges pairs w, w + num_workers, ... and keeps the first error to rethrow
+            std::vector<std::exception_ptr> errors(num_workers);
+            auto merge_pairs = [&parts, &errors, stride, num_pairs, num_workers](size_t worker) {
+                try {
+                    for (size_t pair = worker; pair < num_pairs; pair += num_workers) {
+                        const size_t i = pair * 2 * stride;
+                        parts[i] += parts[i + stride];
+                    }
+                } catch (...) {
+                    errors[worker] = std::current_exception();
+                }
+            };
+            std::vector<std::thread> workers;
+            workers.reserve(num_workers - 1);
+            for (size_t w = 1; w < num_workers; w++) workers.emplace_back(merge_pairs, w);
+            merge_pairs(0);
+            for (auto& worker : workers) worker.join();
+            for (const auto& error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // Reduce a copy of the parts and return the total, the parts are left untouched
+    template <typename Metric>
+    Metric reduce(const std::vector<Metric>& parts, size_t num_threads = 1) {
+        std::vector<Metric> partials(parts);
+        reduceTree(partials, num_threads);
+        return partials.empty() ? Metric() : std::move(partials.front());
+    }
+
+} // namespace metric_merge
+
+#endif //METRIC_MERGE_H
@@ -0,0 +1,147 @@
+//
+// Decoder of raw XMIT/FEM event buffers into per-channel sample spans.
+//
+
+#ifndef RAW_EVENT_DECODER_H
+#define RAW_EVENT_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "constants.h"
+#include "tpc_readout_monitor.h"
+
+/**
+ * Word layout of a raw event buffer as read out through the XMIT.
+ *
+ *  0xFFFFFFFF                       event start marker
+ *  then for every FEM
+ *    0xF | type[27:24] | slot[23:16] | 0   board header, type 1 charge and 2 light
+ *    event number                          as counted by the FEM
+ *    then for every channel
+ *      0x4 | 0[27:12] | channel[11:0]      channel start
+ *      sample words                        two ADC samples per word, sample i in [15:0] and i+1 in [31:16]
+ *      0x5 | samples[27:12] | channel[11:0] channel end, holding the number of samples
+ *  0xE0000000                       event end marker
+ *
+ * Samples are 12-bit, so sample words always have a zero top nibble and can't be mistaken for a
+ * marker. An odd number of samples leaves the upper half of the last word as padding.
+ */
+namespace raw_event {
+
+    constexpr uint32_t kEventStartMarker = 0xFFFFFFFF;
+    constexpr uint32_t kEventEndMarker = 0xE0000000;
+    constexpr uint32_t kTagShift = 28;
+    constexpr uint32_t kBoardHeaderTag = 0xF;
+    constexpr uint32_t kChannelStartTag = 0x4;
+    constexpr uint32_t kChannelEndTag = 0x5;
+    constexpr uint32_t kChannelMask = 0xFFF;
+    constexpr uint32_t kNumSamplesShift = 12;
+    constexpr uint32_t kNumSamplesMask = 0xFFFF;
+
+    // Charge channels read out by each charge FEM, its slot picks the block of global channels
+    constexpr size_t kChargeChannelsPerFem = 64;
+
+    enum class BoardType : uint8_t {
+        kCharge = 1,
+        kLight = 2
+    };
+
+    constexpr uint32_t tag(uint32_t word) { return word >> kTagShift; }
+    constexpr uint32_t boardHeader(BoardType type, uint32_t slot) {
+        return (kBoardHeaderTag << kTagShift) | (static_cast<uint32_t>(type) << 24) | ((slot & 0xFF) << 16);
+    }
+    constexpr uint32_t channelStart(uint32_t channel) { return (kChannelStartTag << kTagShift) | (channel & kChannelMask); }
+    constexpr uint32_t channelEnd(uint32_t channel, uint32_t num_samples) {
+        return (kChannelEndTag << kTagShift) | ((num_samples & kNumSamplesMask) << kNumSamplesShift) | (channel & kChannelMask);
+    }
+
+    /**
+     * @brief Append one synthetic event, for testing and benchmarks without the hardware.
+     * @details Every channel of every FEM gets a noisy baseline with a few pulses on top.
+     * @param out The buffer the event words are appended to.
+     * @param event_number The event number written by each FEM.
+     * @param seed Seeds the noise and pulse positions.
+     * @param num_charge_samples Samples per charge channel.
+     * @param num_light_samples Samples per light channel.
+     */
+    void appendSyntheticEvent(std::vector<uint32_t>& out, uint32_t event_number, uint32_t seed,
+                              size_t num_charge_samples = constants::tpc_readout::NUM_CHARGE_SAMPLES,
+                              size_t num_light_samples = constants::tpc_readout::NUM_LIGHT_SAMPLES);
+
+} // namespace raw_event
+
+// One channel waveform inside the raw buffer, never copied
+struct ChannelSpan {
+    raw_event::BoardType board_type;
+    uint16_t slot;
+    // Channel within the charge or light channels of the detector
+    uint16_t channel;
+    // Samples packed two per word as by PackDoubleWords(), (num_samples + 1) / 2 words
+    const uint32_t* words;
+    size_t num_samples;
+};
+
+// The FEM blocks and channel spans of one event, valid until the buffer is reused
+struct DecodedEvent {
+    uint32_t event_number = 0;
+    std::vector<ChannelSpan> charge_channels;
+    std::vector<ChannelSpan> light_channels;
+    // The event from start to end marker
+    const uint32_t* begin = nullptr;
+    const uint32_t* end = nullptr;
+};
+
+/**
+ * Walks raw event buffers and hands each complete event to a callback as spans into the buffer.
+ *
+ * A malformed event is counted and dropped, and decoding resumes at the next start marker. The
+ * start and end markers seen are counted for the TpcReadoutMonitor.
+ */
+class RawEventDecoder {
+public:
+    using EventCallback = std::function<void(const DecodedEvent&)>;
+
+    explicit RawEventDecoder(EventCallback on_event);
+
+    /**
+     * @brief Decode every complete event in a buffer.
+     * @details An event cut off by the end of the buffer is left unconsumed, so the caller can
+     * carry the words over and decode them again with the rest of the event.
+     * @return A pointer past the last complete event or skipped word.
+     */
+    const uint32_t* decode(const uint32_t* begin, const uint32_t* end);
+    void decode(const std::vector<uint32_t>& buffer) { decode(buffer.data(), buffer.data() + buffer.size()); }
+
+    // Write the marker counts into the readout monitor
+    void publish(TpcReadoutMonitor& monitor) const;
+    void resetCounters();
+
+    // --- Getter Methods ---
+    uint64_t getNumStartMarkers() const { return num_start_markers_; }
+    uint64_t getNumEndMarkers() const { return num_end_markers_; }
+    uint64_t getNumEvents() const { return num_events_; }
+    uint64_t getNumMalformedEvents() const { return num_malformed_events_; }
+    uint64_t getNumSkippedWords() const { return num_skipped_words_; }
+
+private:
+    enum class Status {
+        kComplete,
+        kIncomplete,
+        kMalformed
+    };
+
+    // Parse the event whose start marker is at begin, on success end_out points past its end marker
+    Status parseEvent(const uint32_t* begin, const uint32_t* end, const uint32_t*& end_out);
+
+    EventCallback on_event_;
+    DecodedEvent event_;
+    uint64_t num_start_markers_ = 0;
+    uint64_t num_end_markers_ = 0;
+    uint64_t num_events_ = 0;
+    uint64_t num_malformed_events_ = 0;
+    uint64_t num_skipped_words_ = 0;
+};
+
+#endif //RAW_EVENT_DECODER_H
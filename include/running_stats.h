@@ -0,0 +1,65 @@
+//
+// Streaming mean and standard deviation of ADC samples.
+//
+
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Numerically stable running mean and variance.
+ *
+ * Single values use Welford's update. Whole waveforms are summed a block at a time with exact
+ * integer sums, SIMD when available, and each block is folded in with the pairwise update of
+ * Chan et al., which is also how two accumulators are merged. Integer block sums are exact for
+ * samples below 2^16; a block holding larger values falls back to Welford's update.
+ */
+class RunningStats {
+public:
+    // Bits after the binary point of the fixed-point words on the wire, Q16.16
+    static constexpr uint32_t kFractionBits = 16;
+
+    void add(uint32_t value) {
+        count_++;
+        const double delta = value - mean_;
+        mean_ += delta / static_cast<double>(count_);
+        m2_ += delta * (value - mean_);
+    }
+    void add(const uint32_t* values, size_t num_values);
+    // Samples packed two per word as by PackDoubleWords(), an odd count ignores the last upper half
+    void addPacked(const uint32_t* words, size_t num_samples);
+    void merge(const RunningStats& other);
+    void clear() { *this = RunningStats(); }
+
+    uint64_t getCount() const { return count_; }
+    double getMean() const { return mean_; }
+    // Population variance, 0 until there are samples
+    double getVariance() const { return count_ > 0 ? m2_ / static_cast<double>(count_) : 0.0; }
+    double getStdDev() const { return std::sqrt(getVariance()); }
+
+    /**
+     * @brief Rebuild an accumulator from its summary, e.g. decoded from telemetry, so it can be merged.
+     * @param count Number of samples summarized.
+     * @param mean Their mean.
+     * @param stddev Their population standard deviation.
+     */
+    static RunningStats fromSummary(uint64_t count, double mean, double stddev);
+
+    // Unsigned Q16.16, rounded to nearest and saturated
+    static uint32_t toFixedPoint(double value);
+    static double fromFixedPoint(uint32_t word) { return word / static_cast<double>(1u << kFractionBits); }
+
+private:
+    // Fold in a block of count samples with the given exact sums
+    void mergeBlock(uint64_t count, uint64_t sum, uint64_t sum_squares);
+
+    uint64_t count_ = 0;
+    double mean_ = 0.0;
+    // Sum of squared deviations from the mean
+    double m2_ = 0.0;
+};
+
+#endif //RUNNING_STATS_H
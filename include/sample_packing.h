@@ -0,0 +1,109 @@
+//
+// Packing of ADC waveform samples into 32-bit words for the event metrics.
+//
+
+#ifndef SAMPLE_PACKING_H
+#define SAMPLE_PACKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * How the samples of a waveform are laid out in the payload words. The mode is recorded in
+ * the event header, so each event can pick its own.
+ *
+ *  k16Bit  Two samples per word, sample i in the lower and i+1 in the upper 16 bits. This is the
+ *          original event format; the payload holds only the packed words.
+ *  k12Bit  Eight 12-bit samples per three words, as a little-endian bit stream. The first payload
+ *          word is the number of samples, followed by the packed words.
+ *  kRice   Lossless compression for waveforms sitting near a baseline. Sample to sample
+ *          differences are Rice coded, with an escape to the raw 12-bit value for large jumps. The
+ *          first payload word holds the Rice parameter in [31:27] and the number of samples in
+ *          [26:0], followed by the bit stream.
+ *  kZeroSuppressed  Only the regions of the waveform beyond a threshold around its baseline, plus
+ *          some samples either side. The first payload word holds the baseline in [31:16] and the
+ *          number of samples in [15:0]. Each region follows as one word with its length in [31:16]
+ *          and first sample in [15:0], then its samples two per word as in k16Bit. Regions are in
+ *          increasing order and don't overlap, the samples between them unpack as the baseline.
+ */
+enum class SamplePacking : uint8_t {
+    k16Bit = 0,
+    k12Bit = 1,
+    kRice = 2,
+    kZeroSuppressed = 3
+};
+
+namespace sample_packing {
+
+    // Samples are 12-bit ADC words, higher bits are dropped by the 12-bit packing
+    constexpr uint32_t kAdcMask = 0xFFF;
+
+    bool isValid(uint8_t packing);
+
+    // Number of payload words holding num_samples samples in the given packing, an upper bound for
+    // kRice and kZeroSuppressed
+    size_t packedWords(SamplePacking packing, size_t num_samples);
+
+    /**
+     * @brief Pack samples into payload words.
+     * @details kRice falls back to k12Bit when the waveform does not compress below that size.
+     * kZeroSuppressed needs a baseline and threshold, use packZeroSuppressed() for it.
+     * @param packing The packing mode.
+     * @param samples The samples, one per word.
+     * @param num_samples Number of samples.
+     * @param out Replaced with the packed payload words.
+     * @return The packing actually used.
+     */
+    SamplePacking pack(SamplePacking packing, const uint32_t* samples, size_t num_samples, std::vector<uint32_t>& out);
+
+    /**
+     * @brief Pack a waveform as kZeroSuppressed regions.
+     * @details Samples more than threshold ADC counts from the baseline are kept together with
+     * pre_samples before and post_samples after them. Regions closer than a region header are
+     * merged. Falls back to k16Bit when the regions don't take fewer words than that.
+     * @param out Replaced with the packed payload words.
+     * @return The packing actually used.
+     * @throws std::invalid_argument if num_samples or the baseline does not fit in 16 bits.
+     */
+    SamplePacking packZeroSuppressed(const uint32_t* samples, size_t num_samples, uint32_t baseline,
+                                     uint32_t threshold, uint32_t pre_samples, uint32_t post_samples,
+                                     std::vector<uint32_t>& out);
+
+    /**
+     * @brief Flag the samples outside [low, high], using AVX2 when the CPU supports it.
+     * @param mask ceil(num_samples / 64) words, bit i % 64 of word i / 64 is set for sample i.
+     */
+    void thresholdMask(const uint32_t* samples, size_t num_samples, uint32_t low, uint32_t high, uint64_t* mask);
+
+    // Number of samples stored in a payload, throws std::runtime_error if the payload is malformed
+    size_t numSamples(SamplePacking packing, const uint32_t* words, size_t num_words);
+
+    /**
+     * @brief Unpack payload words into samples, the caller provides numSamples() words of space.
+     * @throws std::runtime_error if the payload is malformed.
+     */
+    void unpack(SamplePacking packing, const uint32_t* words, size_t num_words, uint32_t* samples);
+
+    std::vector<uint32_t> unpack(SamplePacking packing, const std::vector<uint32_t>& words);
+
+    /**
+     * @brief Unpack only the first samples of a payload, e.g. for printing.
+     * @details max_samples is rounded down to a multiple of 8 for the 12-bit packing.
+     * @return The number of samples written, at most max_samples.
+     */
+    size_t unpackHead(SamplePacking packing, const uint32_t* words, size_t num_words, uint32_t* samples,
+                      size_t max_samples);
+
+    /**
+     * Two 16-bit samples per word with sample i in the lower and i+1 in the upper bits. These use
+     * SSE2 or AVX2 when the CPU supports them and fall back to a scalar loop otherwise.
+     */
+    // Writes (num_samples + 1) / 2 words, an odd last sample leaves the upper half zero
+    void packDoubleWords(const uint32_t* samples, size_t num_samples, uint32_t* words);
+    // Writes 2 * num_words samples
+    void unpackDoubleWords(const uint32_t* words, size_t num_words, uint32_t* samples);
+
+} // namespace sample_packing
+
+#endif //SAMPLE_PACKING_H
@@ -0,0 +1,117 @@
+//
+// TpcMonitor filled from several decoder threads at once.
+//
+
+#ifndef SHARDED_TPC_MONITOR_H
+#define SHARDED_TPC_MONITOR_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "cache_aligned.h"
+#include "tpc_monitor.h"
+
+/**
+ * A TpcMonitor split into one shard per worker thread, so the fill path takes no lock.
+ *
+ * Each shard holds two monitors. Its worker fills the active one while snapshot() retires it by
+ * flipping the active index, waits out a fill which may still be writing to it, then merges it
+ * into the snapshot and clears it for reuse. A fill only touches its shard's sequence counter,
+ * odd while inside a fill, which is how snapshot() knows when a retired monitor is quiescent.
+ * Fillers are never blocked by a snapshot.
+ *
+ * Each shard must be filled by a single thread at a time. A fill is two atomic increments, so
+ * batch calls (whole waveforms or events, or update()) are much cheaper than per-sample fills.
+ */
+class ShardedTpcMonitor {
+public:
+    class alignas(kCacheLineSize) Shard {
+    public:
+        /**
+         * @brief Run several fills on the active monitor inside one fill section.
+         * @param fill Called as fill(TpcMonitor&), it must not keep the reference.
+         */
+        template <typename Fill>
+        void update(Fill&& fill) {
+            const uint32_t active = enter();
+            // Leave the fill section even if the fill throws, e.g. for a bad channel
+            struct Section {
+                Shard& shard;
+                ~Section() { shard.leave(); }
+            } section{*this};
+            fill(monitors_[active]);
+        }
+
+        void fillChargeChannelHistogram(size_t channel, uint32_t word) {
+            update([&](TpcMonitor& monitor) { monitor.fillChargeChannelHistogram(channel, word); });
+        }
+        void fillLightChannelHistogram(size_t channel, uint32_t word) {
+            update([&](TpcMonitor& monitor) { monitor.fillLightChannelHistogram(channel, word); });
+        }
+        void fillChargeChannel(size_t channel, const uint32_t* samples, size_t num_samples) {
+            update([&](TpcMonitor& monitor) { monitor.fillChargeChannel(channel, samples, num_samples); });
+        }
+        void fillLightChannel(size_t channel, const uint32_t* samples, size_t num_samples) {
+            update([&](TpcMonitor& monitor) { monitor.fillLightChannel(channel, samples, num_samples); });
+        }
+        void fillChargeChannelPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+            update([&](TpcMonitor& monitor) { monitor.fillChargeChannelPacked(channel, words, num_samples); });
+        }
+        void fillLightChannelPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+            update([&](TpcMonitor& monitor) { monitor.fillLightChannelPacked(channel, words, num_samples); });
+        }
+        void fillEvent(const uint32_t* charge_samples, size_t num_charge_samples,
+                       const uint32_t* light_samples, size_t num_light_samples) {
+            update([&](TpcMonitor& monitor) {
+                monitor.fillEvent(charge_samples, num_charge_samples, light_samples, num_light_samples);
+            });
+        }
+        void fillEventPacked(const uint32_t* charge_words, size_t num_charge_samples,
+                             const uint32_t* light_words, size_t num_light_samples) {
+            update([&](TpcMonitor& monitor) {
+                monitor.fillEventPacked(charge_words, num_charge_samples, light_words, num_light_samples);
+            });
+        }
+
+    private:
+        friend class ShardedTpcMonitor;
+
+        // Mark the shard busy, then read which monitor to fill. Both are sequentially consistent so
+        // either this sees the index flipped by retire() or retire() sees the shard busy.
+        uint32_t enter() {
+            sequence_.fetch_add(1, std::memory_order_seq_cst);
+            return active_.load(std::memory_order_seq_cst);
+        }
+        // Publish the fill to a snapshot() waiting on the sequence counter
+        void leave() { sequence_.fetch_add(1, std::memory_order_release); }
+
+        // Flip the active monitor and wait until no fill can still write to the old one
+        uint32_t retire();
+
+        std::atomic<uint32_t> active_{0};
+        std::atomic<uint64_t> sequence_{0};
+        TpcMonitor monitors_[2];
+    };
+
+    explicit ShardedTpcMonitor(size_t num_shards = constants::daq_computer::NUM_CPUS);
+
+    size_t getNumShards() const { return num_shards_; }
+    // The shard of one worker thread, throws std::out_of_range for an unknown shard
+    Shard& shard(size_t index);
+
+    /**
+     * @brief Merge the counts filled since the previous snapshot into a monitor.
+     * @details Runs alongside the fillers. Counts made while the snapshot is being taken go to
+     * the next one. Concurrent snapshot() calls are serialized.
+     * @param out Cleared and then filled with the merged histograms.
+     */
+    void snapshot(TpcMonitor& out);
+    TpcMonitor snapshot();
+
+private:
+    size_t num_shards_;
+    std::unique_ptr<Shard[]> shards_;
+    std::mutex snapshot_mutex_;
+};
+
+#endif //SHARDED_TPC_MONITOR_H
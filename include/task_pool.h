@@ -0,0 +1,70 @@
+//
+// Small work-stealing thread pool for the parallel event processing.
+//
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cache_aligned.h"
+#include "constants.h"
+
+/**
+ * Fixed set of worker threads, each with its own task deque.
+ *
+ * A worker pops its newest task from the back of its own deque and, once that is empty, steals
+ * the oldest task from the front of another's. Tasks submitted from a worker (nested
+ * parallelFor()) go to that worker's deque, so nested work stays local until someone is idle.
+ * The thread waiting in parallelFor() runs tasks too, so a pool of 0 threads runs everything on
+ * the caller.
+ */
+class TaskPool {
+public:
+    // Defaults to one thread per DAQ computer core, minus the caller which joins in
+    explicit TaskPool(size_t num_threads = constants::daq_computer::NUM_CPUS - 1);
+    ~TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    size_t getNumThreads() const { return threads_.size(); }
+
+    /**
+     * @brief Run body(i) for every i in [0, num_tasks) on the pool and wait for all of them.
+     * @details Safe to call from inside a task. The tasks may run in any order and concurrently.
+     * @throws The first exception thrown by a task, after all tasks have finished.
+     */
+    void parallelFor(size_t num_tasks, const std::function<void(size_t)>& body);
+
+private:
+    using Task = std::function<void()>;
+
+    struct alignas(kCacheLineSize) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void submit(Task task);
+    // Run one task, own queue first then stealing, false if every queue was empty
+    bool runOne();
+    void workerLoop(size_t index);
+
+    // One queue per worker plus a last one for tasks submitted from outside the pool
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_{0};
+
+    // Idle workers sleep until tasks are queued
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> num_queued_{0};
+    bool stop_ = false;
+};
+
+#endif //TASK_POOL_H
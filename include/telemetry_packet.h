@@ -0,0 +1,175 @@
+//
+// Framed telemetry packets holding several serialized metrics.
+//
+
+#ifndef TELEMETRY_PACKET_H
+#define TELEMETRY_PACKET_H
+
+#include "metric_base.h"
+#include <memory>
+
+using pgrams::communication::TelemetryCodes;
+
+/**
+ * Wire format of a telemetry frame, all fields are 32-bit words.
+ *
+ *  Frame header:   [31:16] kFrameMagic   [15:0] number of records
+ *                  total number of record words following the frame header
+ *  Each record:    [31:16] TelemetryCodes  [15:8] format version  [7:0] flags
+ *                  payload length in words
+ *                  sequence number
+ *                  payload (the metric's serialize_into() words)
+ *                  CRC32C of the payload, only if the record has kFlagCrc32c set
+ *
+ * The payload length in the record header includes the CRC32C trailer when present.
+ */
+struct TelemetryPacket {
+    static constexpr uint32_t kFrameMagic = 0x7E1E;
+    static constexpr size_t kFrameHeaderWords = 2;
+    static constexpr size_t kRecordHeaderWords = 3;
+    static constexpr uint8_t kFormatVersion = 1;
+    static constexpr size_t kMaxRecords = 0xFFFF;
+
+    // Record flags
+    static constexpr uint8_t kFlagCrc32c = 0x01;
+
+    static bool isFrameStart(uint32_t word) { return (word >> 16) == kFrameMagic; }
+};
+
+struct RecordHeader {
+    uint16_t code = 0;
+    uint8_t version = TelemetryPacket::kFormatVersion;
+    uint8_t flags = 0;
+    uint32_t num_words = 0;
+    uint32_t sequence = 0;
+
+    TelemetryCodes telemetryCode() const { return static_cast<TelemetryCodes>(code); }
+
+    // Write the header to 3 words, the caller guarantees the space
+    void pack(uint32_t* out) const {
+        out[0] = (static_cast<uint32_t>(code) << 16) | (static_cast<uint32_t>(version) << 8) | flags;
+        out[1] = num_words;
+        out[2] = sequence;
+    }
+
+    // Read the header from 3 words, the caller guarantees the data is long enough
+    static RecordHeader unpack(const uint32_t* words) {
+        RecordHeader header;
+        header.code = static_cast<uint16_t>(words[0] >> 16);
+        header.version = static_cast<uint8_t>((words[0] >> 8) & 0xFF);
+        header.flags = static_cast<uint8_t>(words[0] & 0xFF);
+        header.num_words = words[1];
+        header.sequence = words[2];
+        return header;
+    }
+};
+
+/**
+ * Maps telemetry codes to the metric class decoding them. The lookup is a direct index into a
+ * table addressed by the subsystem nibble and the low byte of the code.
+ */
+class MetricRegistry {
+public:
+    using Factory = std::unique_ptr<MetricBase> (*)();
+
+    MetricRegistry();
+
+    /**
+     * @brief Register the metric class T as the decoder for a telemetry code.
+     * @throws std::invalid_argument if the table slot is already taken by another code.
+     */
+    template <typename T>
+    void add(TelemetryCodes code) {
+        add(pgrams::communication::to_telem_u16(code), [] { return std::unique_ptr<MetricBase>(new T()); });
+    }
+    void add(uint16_t code, Factory factory);
+
+    // Returns a default constructed metric for the code, or nullptr for unknown codes
+    std::unique_ptr<MetricBase> create(uint16_t code) const {
+        const Entry& entry = table_[slot(code)];
+        return entry.factory != nullptr && entry.code == code ? entry.factory() : nullptr;
+    }
+    bool contains(uint16_t code) const {
+        const Entry& entry = table_[slot(code)];
+        return entry.factory != nullptr && entry.code == code;
+    }
+
+    // Registry with every metric in this library registered against its telemetry code
+    static const MetricRegistry& defaults();
+
+private:
+    struct Entry {
+        uint16_t code = 0;
+        Factory factory = nullptr;
+    };
+    static constexpr size_t kNumSlots = 16 * 256;
+    static size_t slot(uint16_t code) { return ((code >> 12) << 8) | (code & 0xFF); }
+
+    std::vector<Entry> table_;
+};
+
+/**
+ * Packs several metrics into one frame. The frame buffer is reused between calls to begin(),
+ * so steady state encoding does no heap allocation.
+ */
+class TelemetryPacketEncoder {
+public:
+    TelemetryPacketEncoder() : num_records_(0), sequence_(0) { begin(); }
+
+    // Start a new, empty frame
+    void begin();
+    // Append a metric record to the current frame, returns its sequence number.
+    // Pass TelemetryPacket::kFlagCrc32c in flags to protect the record with a CRC32C trailer.
+    uint32_t add(TelemetryCodes code, const MetricBase& metric, uint8_t flags = 0);
+    // Complete the frame header and return the frame words
+    const std::vector<uint32_t>& finish();
+
+    size_t getNumRecords() const { return num_records_; }
+    uint32_t getNextSequence() const { return sequence_; }
+    void setNextSequence(uint32_t sequence) { sequence_ = sequence; }
+
+private:
+    std::vector<uint32_t> frame_;
+    size_t num_records_;
+    uint32_t sequence_;
+};
+
+struct DecodedMetric {
+    RecordHeader header;
+    // nullptr if the code has no registered decoder
+    std::unique_ptr<MetricBase> metric;
+};
+
+/**
+ * Decodes frames written by TelemetryPacketEncoder, dispatching each record to the
+ * metric class registered for its telemetry code.
+ */
+class TelemetryPacketDecoder {
+public:
+    explicit TelemetryPacketDecoder(const MetricRegistry& registry = MetricRegistry::defaults())
+        : registry_(registry) {}
+
+    /**
+     * @brief Decode one frame straight out of the caller's buffer.
+     * @param begin Pointer to the frame header.
+     * @param end Pointer one past the last available word.
+     * @param metrics The decoded records are appended here.
+     * @return A pointer to the position after the frame.
+     * @throws std::runtime_error on a malformed frame or record.
+     */
+    const uint32_t* decode(const uint32_t* begin, const uint32_t* end, std::vector<DecodedMetric>& metrics) const;
+    std::vector<DecodedMetric> decode(const std::vector<uint32_t>& frame) const;
+
+    /**
+     * @brief Decode a single record payload into a new metric.
+     * @return The metric, or nullptr if the code has no registered decoder.
+     * @details Records flagged with kFlagCrc32c are verified before they are decoded.
+     * @throws std::runtime_error if the payload does not match the record header or its CRC32C.
+     */
+    std::unique_ptr<MetricBase> decodeRecord(const RecordHeader& header, const uint32_t* payload) const;
+
+private:
+    const MetricRegistry& registry_;
+};
+
+#endif //TELEMETRY_PACKET_H
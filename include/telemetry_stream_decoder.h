@@ -0,0 +1,125 @@
+//
+// Incremental decoder for a byte stream of concatenated telemetry frames.
+//
+
+#ifndef TELEMETRY_STREAM_DECODER_H
+#define TELEMETRY_STREAM_DECODER_H
+
+#include "telemetry_packet.h"
+#include <functional>
+
+/**
+ * Decodes TelemetryPacket frames from a byte stream delivered in arbitrary sized chunks.
+ *
+ * Each metric is handed to the callback as soon as the last word of its record arrives. Only the
+ * record currently being received is held, in a buffer sized once at construction, so the memory
+ * use does not depend on the stream length. Records which arrive whole in one word-aligned chunk
+ * are decoded straight out of the chunk.
+ *
+ * On a malformed frame or record, including a CRC32C mismatch, the decoder drops back to searching the stream, byte by byte,
+ * for the next frame magic, starting again just past the header of the bad frame so a frame
+ * hidden in its bytes is not lost. The bytes of a frame from earlier chunks are kept for this,
+ * up to the size of the largest record. Each time it locks onto a frame after skipping data a
+ * resync point is reported.
+ *
+ * Words are expected little-endian on the wire, the byte order of the flight and ground computers.
+ */
+class TelemetryStreamDecoder {
+public:
+    using MetricCallback = std::function<void(const RecordHeader&, std::unique_ptr<MetricBase>)>;
+
+    struct ResyncPoint {
+        uint64_t stream_offset;  // byte offset of the frame header the decoder locked onto
+        uint64_t skipped_bytes;  // bytes discarded since the last good frame
+    };
+    using ResyncCallback = std::function<void(const ResyncPoint&)>;
+
+    // Enough for the largest metric in this library with plenty of headroom
+    static constexpr size_t kDefaultMaxRecordWords = 1 << 16;
+
+    explicit TelemetryStreamDecoder(MetricCallback on_metric, size_t max_record_words = kDefaultMaxRecordWords,
+                                    const MetricRegistry& registry = MetricRegistry::defaults());
+
+    /**
+     * @brief Feed the next chunk of the stream, any size including partial words.
+     * @details Metric and resync callbacks are invoked from within this call.
+     */
+    void feed(const uint8_t* data, size_t num_bytes);
+    void feed(const std::vector<uint8_t>& data) { feed(data.data(), data.size()); }
+
+    // Forget any partial frame and search for the next frame magic
+    void reset();
+
+    void setResyncCallback(ResyncCallback on_resync) { on_resync_ = std::move(on_resync); }
+
+    // --- Getter Methods ---
+    uint64_t getStreamOffset() const { return stream_offset_; }
+    uint64_t getNumFrames() const { return num_frames_; }
+    uint64_t getNumMetrics() const { return num_metrics_; }
+    uint64_t getNumUnknownRecords() const { return num_unknown_records_; }
+    uint64_t getNumResyncs() const { return num_resyncs_; }
+    // Includes the bytes skipped since the last frame was found
+    uint64_t getNumSkippedBytes() const { return total_skipped_bytes_ + skipped_bytes_; }
+    uint64_t getNumCorruptFrames() const { return num_corrupt_frames_; }
+
+private:
+    enum class State {
+        kSeekFrame,
+        kFrameLength,
+        kRecordHeader,
+        kPayload
+    };
+
+    // Decode data from pos until it runs out or a frame turns out corrupt, pos is left after the last byte used
+    void scan(const uint8_t* data, size_t num_bytes, size_t& pos);
+    // Account for searching the bad frame again, buffer_bytes of it in the buffer being scanned
+    void beginRescan(size_t buffer_bytes);
+    // Search the bytes of a bad frame kept from earlier chunks
+    void rescanHistory();
+    void keepHistory(const uint8_t* data, size_t num_bytes);
+    // Handle one complete word while locked onto a frame
+    void consumeWord(uint32_t word);
+    // Called once the whole payload of the current record is available, false if it was corrupt
+    bool emitRecord(const uint32_t* payload);
+    void finishRecord();
+    void endFrame();
+    // Drop the current frame, feed() then searches its bytes again
+    void corrupt();
+
+    MetricCallback on_metric_;
+    ResyncCallback on_resync_;
+    TelemetryPacketDecoder decoder_;
+    size_t max_record_words_;
+
+    State state_;
+    uint32_t window_;           // last 4 bytes seen while searching for the frame magic
+    size_t window_bytes_;
+    uint32_t partial_word_;     // bytes of the current word received so far
+    size_t partial_bytes_;
+
+    size_t records_left_;       // records still to come in the current frame
+    size_t frame_words_left_;   // words still to come in the current frame
+    std::array<uint32_t, TelemetryPacket::kRecordHeaderWords> header_words_;
+    size_t header_words_received_;
+    RecordHeader header_;
+    std::vector<uint32_t> payload_;
+    size_t payload_received_;
+
+    uint32_t frame_header_;     // header word of the current frame
+    size_t frame_begin_;        // first byte of the current frame after its header in the buffer being scanned
+    std::vector<uint8_t> history_;  // bytes of the current frame from earlier chunks
+    uint64_t history_lost_;     // bytes of the current frame from earlier chunks which did not fit the history
+    std::vector<uint8_t> rescan_;   // a bad frame's history being searched again
+    bool corrupted_;
+
+    uint64_t stream_offset_;
+    uint64_t skipped_bytes_;
+    uint64_t total_skipped_bytes_;
+    uint64_t num_frames_;
+    uint64_t num_metrics_;
+    uint64_t num_unknown_records_;
+    uint64_t num_resyncs_;
+    uint64_t num_corrupt_frames_;
+};
+
+#endif //TELEMETRY_STREAM_DECODER_H
@@ -59,7 +59,7 @@ private:
     std::array<uint32_t, NUM_LIGHT_CHANNELS> disc_threshold_4_;
 
     // // Implement  the serialize/deserialize
-    size_t num_members_ = 15;
+    static constexpr size_t num_members_ = 17;
 
     auto member_tuple() {
         return std::tie(summed_peak_thresh_, channel_multiplicity_,
@@ -80,13 +80,18 @@ private:
 public:
     TpcConfigs();
 
+    // Fixed wire layout: scalar members, trigger prescales then the two discriminator threshold arrays
+    using Layout = WireLayout<num_members_, NUM_PRESCALES, NUM_LIGHT_CHANNELS, NUM_LIGHT_CHANNELS>;
+    static constexpr size_t kWireWords = Layout::kWireWords;
+
     void clear();
     void print() const;
 
     // MetricBase interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    std::array<uint32_t, kWireWords> serialize_array() const;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 
     // Helper for trigger selection
     std::string toTriggerSourceString(uint32_t code) {
@@ -7,28 +7,89 @@
 
 #include "metric_base.h"
 #include "histogram.h"
+#include "running_stats.h"
 
 class TpcMonitor : public MetricBase {
 private:
-    std::vector<Histogram> charge_histograms;
-    std::vector<Histogram> light_histograms;
-    std::vector<uint32_t> channel_mean;
-    std::vector<uint32_t> channel_stddev;
+    // One dense block per detector, see HistogramBlock
+    HistogramBlock charge_histograms;
+    HistogramBlock light_histograms;
+    // Running mean/stddev of every charge channel, sent as Q16.16 fixed point
+    std::vector<RunningStats> charge_stats;
 
 public:
     TpcMonitor();
 
     void clear();
     void print() const;
-    const std::vector<Histogram>& getChargeHistograms() const { return charge_histograms; }
-    const std::vector<Histogram>& getLightHistograms() const { return light_histograms; }
-    void fillChargeChannelHistogram(size_t channel, uint32_t word) { charge_histograms.at(channel).fill(word); };
-    void fillLightChannelHistogram(size_t channel, uint32_t word) { light_histograms.at(channel).fill(word); };
+    // Per-channel views into the histogram blocks, valid while the monitor is alive
+    std::vector<HistogramView> getChargeHistograms() const { return charge_histograms.views(); }
+    std::vector<HistogramView> getLightHistograms() const { return light_histograms.views(); }
+    const HistogramBlock& getChargeHistogramBlock() const { return charge_histograms; }
+    const HistogramBlock& getLightHistogramBlock() const { return light_histograms; }
+    // Mean and population stddev of the samples filled into a charge channel
+    const RunningStats& getChargeChannelStats(size_t channel) const { return charge_stats.at(channel); }
+    double getChargeChannelMean(size_t channel) const { return getChargeChannelStats(channel).getMean(); }
+    double getChargeChannelStdDev(size_t channel) const { return getChargeChannelStats(channel).getStdDev(); }
+    void fillChargeChannelHistogram(size_t channel, uint32_t word) {
+        charge_histograms.fill(channel, word);
+        charge_stats[channel].add(word);
+    };
+    void fillLightChannelHistogram(size_t channel, uint32_t word) { light_histograms.fill(channel, word); };
+
+    // Fill a whole channel waveform at once, see Histogram::fill(const uint32_t*, size_t)
+    void fillChargeChannel(size_t channel, const uint32_t* samples, size_t num_samples) {
+        charge_histograms.fill(channel, samples, num_samples);
+        charge_stats[channel].add(samples, num_samples);
+    }
+    void fillChargeChannel(size_t channel, const std::vector<uint32_t>& samples) {
+        fillChargeChannel(channel, samples.data(), samples.size());
+    }
+    void fillLightChannel(size_t channel, const uint32_t* samples, size_t num_samples) {
+        light_histograms.fill(channel, samples, num_samples);
+    }
+    void fillLightChannel(size_t channel, const std::vector<uint32_t>& samples) {
+        fillLightChannel(channel, samples.data(), samples.size());
+    }
+
+    // Fill a whole channel waveform from samples packed two per word, see Histogram::fillPacked()
+    void fillChargeChannelPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+        charge_histograms.fillPacked(channel, words, num_samples);
+        charge_stats[channel].addPacked(words, num_samples);
+    }
+    void fillLightChannelPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+        light_histograms.fillPacked(channel, words, num_samples);
+    }
+
+    /**
+     * @brief Fill every channel from one event.
+     * @param charge_samples NUM_CHARGE_CHANNELS waveforms stored one after the other, or nullptr.
+     * @param num_charge_samples Samples per charge waveform.
+     * @param light_samples NUM_LIGHT_CHANNELS waveforms stored one after the other, or nullptr.
+     * @param num_light_samples Samples per light waveform.
+     */
+    void fillEvent(const uint32_t* charge_samples, size_t num_charge_samples,
+                   const uint32_t* light_samples, size_t num_light_samples);
+
+    /**
+     * @brief Fill every channel from one event with samples packed two per word.
+     * @details Each waveform starts on a word boundary and takes (num_samples + 1) / 2 words.
+     */
+    void fillEventPacked(const uint32_t* charge_words, size_t num_charge_samples,
+                         const uint32_t* light_words, size_t num_light_samples);
+
+    /**
+     * @brief Add the histograms of another monitor, e.g. one filled by another thread or a
+     * downlinked snapshot of the same run. The charge channel mean/stddev are combined as well.
+     * @throws std::invalid_argument if the histogram binnings differ.
+     */
+    void merge(const TpcMonitor& other);
+    TpcMonitor& operator+=(const TpcMonitor& other) { merge(other); return *this; }
 
     // MetricBase serialize interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 #ifdef USE_PYTHON
     py::dict getMetricDict() override;
 #endif
@@ -16,6 +16,9 @@ private:
     uint32_t run_number_;
     uint32_t file_number_;
     uint32_t evt_number_;
+    // Events the monitor pipeline processed and skipped under load shedding, see LoadShedder
+    uint32_t num_processed_events_;
+    uint32_t num_skipped_events_;
     std::array<uint32_t, DOUBLE_PACK_CHARGE_CH> charge_baselines_;
     std::array<uint32_t, DOUBLE_PACK_CHARGE_CH> charge_rms_;
     std::array<uint32_t, DOUBLE_PACK_CHARGE_CH> charge_avg_num_hits_;
@@ -32,17 +35,24 @@ private:
     };
 
     // Implement  the serialize/deserialize
-    size_t num_members_ = 4;
+    static constexpr size_t num_members_ = 6;
     auto member_tuple() {
-        return std::tie(error_bit_word_, run_number_, file_number_, evt_number_);
+        return std::tie(error_bit_word_, run_number_, file_number_, evt_number_, num_processed_events_,
+                        num_skipped_events_);
     };
     auto member_tuple() const {
-        return std::tie(error_bit_word_, run_number_, file_number_, evt_number_);
+        return std::tie(error_bit_word_, run_number_, file_number_, evt_number_, num_processed_events_,
+                        num_skipped_events_);
     };
 
 public:
     LowBwTpcMonitor();
 
+    // Fixed wire layout: scalar members followed by the packed charge and light channel arrays
+    using Layout = WireLayout<num_members_, DOUBLE_PACK_CHARGE_CH, DOUBLE_PACK_CHARGE_CH, DOUBLE_PACK_CHARGE_CH,
+                              DOUBLE_PACK_LIGHT_CH, DOUBLE_PACK_LIGHT_CH, DOUBLE_PACK_LIGHT_CH>;
+    static constexpr size_t kWireWords = Layout::kWireWords;
+
     // Helper to set the error word bits
     inline void setErrorBitWord(uint32_t set_bit) { error_bit_word_ |= (0x1 << set_bit); }
     inline static uint32_t getErrorBitWord(uint32_t error_word, uint32_t set_bit) { return error_word & (0x1 << set_bit); }
@@ -67,21 +77,21 @@ public:
     template<size_t N, size_t M>
     void PackDoubleWords(std::array<uint32_t, N> &source_array, std::array<uint32_t, M> &dest_array) {
         // Packing two 16b per 32b words with i+1 in upper and i in the lower bits
-        for (size_t i = 0; i < M; i++) {
-            dest_array[i] = ((source_array[2 * i + 1]  & 0xFFFF) << 16) + (source_array[2 * i] & 0xFFFF);
-        }
+        static_assert((N + 1) / 2 == M, "Packed array must hold exactly two source words per word");
+        sample_packing::packDoubleWords(source_array.data(), N, dest_array.data());
+    }
+
+    // Unpack into a caller provided buffer with space for 2 * M words
+    template<size_t M>
+    static void UnPackDoubleWords(const std::array<uint32_t, M> &source_array, uint32_t *dest) {
+        sample_packing::unpackDoubleWords(source_array.data(), M, dest);
     }
 
     template<size_t M>
     std::vector<uint32_t> UnPackDoubleWords(std::array<uint32_t, M> &source_array) {
         // Unpacking two 16b per 32b words with i+1 in upper and i in the lower bits
-        // std::array<uint32_t, 2*M> dest_array;
-        std::vector<uint32_t> dest_array;
-        dest_array.resize(2 * M);
-        for (size_t i = 0; i < M; i++) {
-            dest_array[2 * i] = source_array[i] & 0xFFFF;
-            dest_array[2 * i + 1] = (source_array[i] >> 16) & 0xFFFF;
-        }
+        std::vector<uint32_t> dest_array(2 * M);
+        UnPackDoubleWords(source_array, dest_array.data());
         return dest_array;
     }
 
@@ -105,6 +115,8 @@ public:
     void setRunNumber(uint32_t run_number) { run_number_ = run_number; }
     void setFileNumber(uint32_t file_number) { file_number_ = file_number; }
     void setEvtNumber(uint32_t evt_number) { evt_number_ = evt_number; }
+    void setNumProcessedEvents(uint32_t num_events) { num_processed_events_ = num_events; }
+    void setNumSkippedEvents(uint32_t num_events) { num_skipped_events_ = num_events; }
     void setChargeBaselines(std::array<uint32_t, NUM_CHARGE_CHANNELS> &baselines) {
         PackDoubleWords(baselines, charge_baselines_);
     }
@@ -128,6 +140,8 @@ public:
     const uint32_t getRunNumber() const { return run_number_; }
     const uint32_t getFileNumber() const { return file_number_; }
     const uint32_t getEvtNumber() const { return evt_number_; }
+    uint32_t getNumProcessedEvents() const { return num_processed_events_; }
+    uint32_t getNumSkippedEvents() const { return num_skipped_events_; }
     const std::array<uint32_t, DOUBLE_PACK_CHARGE_CH>& getChargeBaselines() const { return charge_baselines_; }
     const std::array<uint32_t, DOUBLE_PACK_CHARGE_CH>& getChargeRms() const { return charge_rms_; }
     const std::array<uint32_t, DOUBLE_PACK_CHARGE_CH>& getAvgNumHits() const { return charge_avg_num_hits_; }
@@ -137,9 +151,10 @@ public:
     const std::array<uint32_t, DOUBLE_PACK_LIGHT_CH>& getLightAvgNumRois() const { return light_avg_num_rois_; }
 
     // MetricBase interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    std::array<uint32_t, kWireWords> serialize_array() const;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 
 #ifdef USE_PYTHON
     py::dict getMetricDict() override;
@@ -6,6 +6,7 @@
 #define TPC_MONITOR_LIGHT_EVENT_H
 
 #include "metric_base.h"
+#include "sample_packing.h"
 
 using namespace constants::tpc_readout;
 
@@ -13,15 +14,20 @@ class TpcMonitorLightEvent : public MetricBase {
 
 private:
 
+    // [31:28] SamplePacking of the samples, [27:0] channel number
     uint32_t channel_number_;
     uint32_t run_number_;
     uint32_t file_number_;
     uint32_t evt_number_;
     uint32_t num_samples_;
+    // Packed payload words, num_samples_ of them
     std::vector<uint32_t> light_samples_{};
 
+    static constexpr uint32_t kPackingShift = 28;
+    static constexpr uint32_t kChannelMask = (1u << kPackingShift) - 1;
+
     // Implement  the serialize/deserialize
-    size_t num_members_ = 5;
+    static constexpr size_t num_members_ = 5;
     auto member_tuple() {
         return std::tie(channel_number_, run_number_, file_number_, evt_number_, num_samples_);
     };
@@ -31,50 +37,70 @@ private:
 
 public:
 
+    // Words serialize_into() writes ahead of the payload
+    static constexpr size_t kHeaderWords = num_members_;
+
     TpcMonitorLightEvent();
     void clear();
     void print();
 
     void PackDoubleWords(std::vector<uint32_t> &source_array, std::vector<uint32_t> &dest_array) {
         // Packing two 16b per 32b words with i+1 in upper and i in the lower bits
-        for (size_t i = 0; i < dest_array.size(); i++) {
-            dest_array[i] = ((source_array[2 * i + 1]  & 0xFFFF) << 16) + (source_array[2 * i] & 0xFFFF);
-        }
+        sample_packing::packDoubleWords(source_array.data(), std::min(source_array.size(), 2 * dest_array.size()),
+                                        dest_array.data());
+    }
+
+    // Unpack into a caller provided buffer with space for 2 * source_array.size() words
+    static void UnPackDoubleWords(const std::vector<uint32_t> &source_array, uint32_t *dest) {
+        sample_packing::unpackDoubleWords(source_array.data(), source_array.size(), dest);
     }
 
     std::vector<uint32_t> UnPackDoubleWords(std::vector<uint32_t> &source_array) {
         // Unpacking two 16b per 32b words with i+1 in upper and i in the lower bits
-        std::vector<uint32_t> dest_array;
-        dest_array.resize(2 * source_array.size());
-        for (size_t i = 0; i < source_array.size(); i++) {
-            dest_array[2 * i] = source_array[i] & 0xFFFF;
-            dest_array[2 * i + 1] = (source_array[i] >> 16) & 0xFFFF;
-        }
+        std::vector<uint32_t> dest_array(2 * source_array.size());
+        UnPackDoubleWords(source_array, dest_array.data());
         return dest_array;
     }
 
-    void setChannelNumber(uint32_t channel_number) { channel_number_ = channel_number; }
+    void setChannelNumber(uint32_t channel_number) {
+        channel_number_ = (channel_number_ & ~kChannelMask) | (channel_number & kChannelMask);
+    }
     void setRunNumber(uint32_t run_number) { run_number_ = run_number; }
     void setFileNumber(uint32_t file_number) { file_number_ = file_number; }
     void setEvtNumber(uint32_t evt_number) { evt_number_ = evt_number; }
-    void setLightSamples(std::vector<uint32_t> &light_roi) {
-        num_samples_ = (light_roi.size() + 1) / 2;
-        light_samples_.resize(num_samples_);
-        PackDoubleWords(light_roi, light_samples_);
+    void setLightSamples(std::vector<uint32_t> &light_roi, SamplePacking packing = SamplePacking::k16Bit) {
+        const SamplePacking used = sample_packing::pack(packing, light_roi.data(), light_roi.size(), light_samples_);
+        num_samples_ = light_samples_.size();
+        channel_number_ = (channel_number_ & kChannelMask) | (static_cast<uint32_t>(used) << kPackingShift);
+    }
+
+    // Preallocate room for num_words payload words, so setting samples up to that size never allocates
+    void reserveSamples(size_t num_words) { light_samples_.reserve(num_words); }
+
+    // Take samples already packed two per word, the k16Bit payload, e.g. straight from the raw buffer
+    void setLightSamplesPacked(const uint32_t* words, size_t num_words) {
+        light_samples_.assign(words, words + num_words);
+        num_samples_ = light_samples_.size();
+        channel_number_ = (channel_number_ & kChannelMask) | (static_cast<uint32_t>(SamplePacking::k16Bit) << kPackingShift);
     }
 
     // --- Getter Methods ---
-    const uint32_t getChannelNumber() const { return channel_number_; }
+    uint32_t getChannelNumber() const { return channel_number_ & kChannelMask; }
+    SamplePacking getPacking() const { return static_cast<SamplePacking>(channel_number_ >> kPackingShift); }
     const uint32_t getRunNumber() const { return run_number_; }
     const uint32_t getFileNumber() const { return file_number_; }
     const uint32_t getEvtNumber() const { return evt_number_; }
     const uint32_t getNumSamples() const { return num_samples_; }
+    // The packed payload words, see getUnpackedLightSamples() for the ADC values
     const std::vector<uint32_t>& getLightSamples() const { return light_samples_; }
+    // Words serialize_into() writes, the header and the payload
+    size_t getNumWords() const { return kHeaderWords + light_samples_.size(); }
+    std::vector<uint32_t> getUnpackedLightSamples() const { return sample_packing::unpack(getPacking(), light_samples_); }
 
     // MetricBase interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 
 #ifdef USE_PYTHON
     py::dict getMetricDict() override;
@@ -20,6 +20,10 @@ public:
     // Default constructor for deserialization purposes
     TpcMonitorQuery();
 
+    // Fixed wire layout: one slot word per FEM
+    using Layout = WireLayout<NUM_FEMS>;
+    static constexpr size_t kWireWords = Layout::kWireWords;
+
     // Public API
     void clear();
     void print() const;
@@ -28,9 +32,10 @@ public:
     const std::array<uint32_t, NUM_FEMS>& getFemSlots() const { return fem_slots_; }
 
     // MetricBase interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    std::array<uint32_t, kWireWords> serialize_array() const;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 
 #ifdef USE_PYTHON
     py::dict getMetricDict() override;
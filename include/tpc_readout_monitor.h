@@ -52,7 +52,7 @@ private:
       };
 
     // Implement  the serialize/deserialize
-    size_t num_members_ = 20;
+    static constexpr size_t num_members_ = 20;
     auto member_tuple() {
         return std::tie(error_bit_word_, num_rw_buffer_overflow_, readout_state_, last_command_, last_command_status_,
                       run_number_, num_events_upper_, num_events_lower_,
@@ -77,6 +77,10 @@ private:
 public:
     TpcReadoutMonitor();
 
+    // Fixed wire layout: scalar members followed by the board status words
+    using Layout = WireLayout<num_members_, NUM_BOARDS>;
+    static constexpr size_t kWireWords = Layout::kWireWords;
+
     // Assign errors to the bits in the error word
     enum ErrorBits : uint32_t {
         daq_state_cmd = 1,
@@ -163,9 +167,10 @@ public:
     const std::array<uint32_t, NUM_BOARDS> getBoardStatus() const { return board_status_; }
 
     // MetricBase interface implementation
-    std::vector<uint32_t> serialize() const override;
-    std::vector<uint32_t>::const_iterator deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                     std::vector<uint32_t>::const_iterator end) override;
+    std::array<uint32_t, kWireWords> serialize_array() const;
+    void serialize_into(std::vector<uint32_t>& out) const override;
+    using MetricBase::deserialize;
+    const uint32_t* deserialize(const uint32_t* begin, const uint32_t* end) override;
 
 #ifdef USE_PYTHON
     py::dict getMetricDict() override;
@@ -0,0 +1,61 @@
+//
+// Zero suppression of charge waveform snapshots with the per-channel baseline and RMS.
+//
+
+#ifndef ZERO_SUPPRESSION_H
+#define ZERO_SUPPRESSION_H
+
+#include <array>
+#include <vector>
+#include "sample_packing.h"
+#include "tpc_configs.h"
+#include "tpc_monitor_lbw.h"
+#include "tpc_monitor_charge_event.h"
+
+struct ZeroSuppressionConfig {
+    // Threshold from the baseline in units of the channel RMS, never below min_threshold ADC counts
+    double threshold_sigma = 5.0;
+    uint32_t min_threshold = 20;
+    // Samples kept before and after each region beyond the threshold
+    uint32_t pre_samples = 8;
+    uint32_t post_samples = 16;
+
+    // The ROI window of the readout, roi_precount samples before and the rest of the
+    // num_roi_words samples after, with the default thresholds
+    static ZeroSuppressionConfig fromTpcConfigs(const TpcConfigs& configs);
+};
+
+/**
+ * Packs charge waveforms as SamplePacking::kZeroSuppressed regions, each channel with its own
+ * baseline and threshold.
+ *
+ * The baselines and RMS come from the LowBwTpcMonitor published by LbwStatsEngine, so the
+ * thresholds follow the noise of each channel. Until setChannels() is called every channel has a
+ * zero baseline and keeps everything above min_threshold.
+ */
+class ZeroSuppressor {
+public:
+    // Throws std::invalid_argument if threshold_sigma is negative
+    explicit ZeroSuppressor(const ZeroSuppressionConfig& config = ZeroSuppressionConfig());
+
+    // Baseline and threshold of every charge channel from the monitor's baseline and RMS fields
+    void setChannels(const LowBwTpcMonitor& monitor);
+    // Throws std::out_of_range for channels past NUM_CHARGE_CHANNELS
+    void setChannel(size_t channel, uint32_t baseline, double rms);
+
+    // Pack one waveform of the channel, returns the packing used
+    SamplePacking encode(size_t channel, const uint32_t* samples, size_t num_samples, std::vector<uint32_t>& out) const;
+    // Set the event's samples, zero suppressed with the baseline and threshold of its channel
+    void setChargeSamples(TpcMonitorChargeEvent& event, const std::vector<uint32_t>& samples) const;
+
+    const ZeroSuppressionConfig& getConfig() const { return config_; }
+    uint32_t getBaseline(size_t channel) const { return baselines_.at(channel); }
+    uint32_t getThreshold(size_t channel) const { return thresholds_.at(channel); }
+
+private:
+    ZeroSuppressionConfig config_;
+    std::array<uint32_t, NUM_CHARGE_CHANNELS> baselines_{};
+    std::array<uint32_t, NUM_CHARGE_CHANNELS> thresholds_{};
+};
+
+#endif //ZERO_SUPPRESSION_H
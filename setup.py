@@ -14,7 +14,21 @@ sources = [
     'src/daq_comp_monitor.cpp',
     'src/tpc_readout_monitor.cpp',
     'src/tpc_monitor_charge_event.cpp',
-    'src/tpc_monitor_light_event.cpp'
+    'src/tpc_monitor_light_event.cpp',
+    'src/tpc_monitor_query.cpp',
+    'src/telemetry_packet.cpp',
+    'src/telemetry_stream_decoder.cpp',
+    'src/crc32c.cpp',
+    'src/sample_packing.cpp',
+    'src/sharded_tpc_monitor.cpp',
+    'src/running_stats.cpp',
+    'src/lbw_stats_engine.cpp',
+    'src/raw_event_decoder.cpp',
+    'src/event_pipeline.cpp',
+    'src/task_pool.cpp',
+    'src/load_shedder.cpp',
+    'src/event_block.cpp',
+    'src/zero_suppression.cpp'
 ]
 
 ext_modules = [
@@ -0,0 +1,211 @@
+//
+// CRC32C (Castagnoli) checksum used for the metric integrity trailers.
+//
+
+#include "../include/crc32c.h"
+#include "../include/cpu_features.h"
+#include <array>
+#include <cstring>
+
+#if defined(DATAMON_X86_DISPATCH) && defined(__x86_64__)
+    #include <nmmintrin.h>
+    #define DATAMON_CRC32C_SSE42 1
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+#endif
+
+namespace {
+
+    // Reflected Castagnoli polynomial
+    constexpr uint32_t kPolynomial = 0x82F63B78;
+
+    using SliceTables = std::array<std::array<uint32_t, 256>, 8>;
+
+    constexpr SliceTables makeTables() {
+        SliceTables tables{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ kPolynomial : crc >> 1;
+            }
+            tables[0][i] = crc;
+        }
+        for (size_t slice = 1; slice < 8; slice++) {
+            for (size_t i = 0; i < 256; i++) {
+                const uint32_t prev = tables[slice - 1][i];
+                tables[slice][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+            }
+        }
+        return tables;
+    }
+
+    constexpr SliceTables kTables = makeTables();
+
+    // Slice-by-8, the crc passed in and returned is not inverted
+    uint32_t crcSliceBy8(uint32_t crc, const uint8_t* data, size_t num_bytes) {
+        while (num_bytes >= 8) {
+            const uint32_t lo = crc ^ (static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+                                       static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24);
+            const uint32_t hi = static_cast<uint32_t>(data[4]) | static_cast<uint32_t>(data[5]) << 8 |
+                                static_cast<uint32_t>(data[6]) << 16 | static_cast<uint32_t>(data[7]) << 24;
+            crc = kTables[7][lo & 0xFF] ^ kTables[6][(lo >> 8) & 0xFF] ^
+                  kTables[5][(lo >> 16) & 0xFF] ^ kTables[4][lo >> 24] ^
+                  kTables[3][hi & 0xFF] ^ kTables[2][(hi >> 8) & 0xFF] ^
+                  kTables[1][(hi >> 16) & 0xFF] ^ kTables[0][hi >> 24];
+            data += 8;
+            num_bytes -= 8;
+        }
+        while (num_bytes-- > 0) {
+            crc = (crc >> 8) ^ kTables[0][(crc ^ *data++) & 0xFF];
+        }
+        return crc;
+    }
+
+#if defined(DATAMON_CRC32C_SSE42)
+    /*
+     * The crc32 instruction has a latency of 3 cycles but a throughput of 1 per cycle, so long
+     * buffers are split into three interleaved streams whose CRCs are merged afterwards. Merging
+     * shifts a CRC over the length of the following stream, i.e. multiplies it by x^(8*len)
+     * modulo the polynomial, which is applied with a table built from the GF(2) operator matrix.
+     * Each merge waits on the streams, so the blocks are as long as the buffer allows: a metric
+     * of a few tens of kB goes through the middle size rather than 256 byte blocks.
+     */
+    constexpr size_t kLongBlock = 8192;
+    constexpr size_t kMidBlock = 2048;
+    constexpr size_t kShortBlock = 256;
+
+    using ShiftTable = std::array<std::array<uint32_t, 256>, 4>;
+    using Gf2Matrix = std::array<uint32_t, 32>;
+
+    constexpr uint32_t gf2MatrixTimes(const Gf2Matrix& mat, uint32_t vec) {
+        uint32_t sum = 0;
+        for (size_t n = 0; vec != 0; n++, vec >>= 1) {
+            if (vec & 1) sum ^= mat[n];
+        }
+        return sum;
+    }
+
+    constexpr Gf2Matrix gf2MatrixSquare(const Gf2Matrix& mat) {
+        Gf2Matrix square{};
+        for (size_t n = 0; n < 32; n++) square[n] = gf2MatrixTimes(mat, mat[n]);
+        return square;
+    }
+
+    // Operator appending num_bytes zero bytes to a CRC, num_bytes must be a power of 2
+    constexpr ShiftTable makeShiftTable(size_t num_bytes) {
+        Gf2Matrix op{};
+        op[0] = kPolynomial;  // one zero bit
+        for (size_t n = 1; n < 32; n++) op[n] = 1u << (n - 1);
+        for (size_t bits = 8 * num_bytes; bits > 1; bits >>= 1) op = gf2MatrixSquare(op);
+
+        ShiftTable table{};
+        for (uint32_t n = 0; n < 256; n++) {
+            for (size_t byte = 0; byte < 4; byte++) table[byte][n] = gf2MatrixTimes(op, n << (8 * byte));
+        }
+        return table;
+    }
+
+    constexpr ShiftTable kLongShift = makeShiftTable(kLongBlock);
+    constexpr ShiftTable kMidShift = makeShiftTable(kMidBlock);
+    constexpr ShiftTable kShortShift = makeShiftTable(kShortBlock);
+
+    inline uint32_t shiftCrc(const ShiftTable& table, uint32_t crc) {
+        return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^ table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+    }
+
+    template <size_t kBlock>
+    __attribute__((target("sse4.2")))
+    inline uint64_t crcSse42ThreeWay(uint64_t crc0, const uint8_t*& data, size_t& num_bytes, const ShiftTable& shift) {
+        while (num_bytes >= 3 * kBlock) {
+            uint64_t crc1 = 0;
+            uint64_t crc2 = 0;
+            for (size_t i = 0; i < kBlock; i += 8) {
+                uint64_t word0, word1, word2;
+                std::memcpy(&word0, data + i, sizeof(word0));
+                std::memcpy(&word1, data + i + kBlock, sizeof(word1));
+                std::memcpy(&word2, data + i + 2 * kBlock, sizeof(word2));
+                crc0 = _mm_crc32_u64(crc0, word0);
+                crc1 = _mm_crc32_u64(crc1, word1);
+                crc2 = _mm_crc32_u64(crc2, word2);
+            }
+            crc0 = shiftCrc(shift, static_cast<uint32_t>(crc0)) ^ crc1;
+            crc0 = shiftCrc(shift, static_cast<uint32_t>(crc0)) ^ crc2;
+            data += 3 * kBlock;
+            num_bytes -= 3 * kBlock;
+        }
+        return crc0;
+    }
+
+    __attribute__((target("sse4.2")))
+    uint32_t crcSse42(uint32_t crc, const uint8_t* data, size_t num_bytes) {
+        uint64_t crc64 = crc;
+        crc64 = crcSse42ThreeWay<kLongBlock>(crc64, data, num_bytes, kLongShift);
+        crc64 = crcSse42ThreeWay<kMidBlock>(crc64, data, num_bytes, kMidShift);
+        crc64 = crcSse42ThreeWay<kShortBlock>(crc64, data, num_bytes, kShortShift);
+        while (num_bytes >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+            data += 8;
+            num_bytes -= 8;
+        }
+        crc = static_cast<uint32_t>(crc64);
+        while (num_bytes-- > 0) {
+            crc = _mm_crc32_u8(crc, *data++);
+        }
+        return crc;
+    }
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+    uint32_t crcArmv8(uint32_t crc, const uint8_t* data, size_t num_bytes) {
+        while (num_bytes >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc = __crc32cd(crc, word);
+            data += 8;
+            num_bytes -= 8;
+        }
+        while (num_bytes-- > 0) {
+            crc = __crc32cb(crc, *data++);
+        }
+        return crc;
+    }
+#endif
+
+    using CrcKernel = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+    CrcKernel selectKernel() {
+#if defined(__ARM_FEATURE_CRC32)
+        return crcArmv8;
+#endif
+#if defined(DATAMON_CRC32C_SSE42)
+        if (cpu_features::hasSse42()) return crcSse42;
+#endif
+        return crcSliceBy8;
+    }
+
+    // Chosen on first use so the checksum is also safe to use during static initialization
+    CrcKernel kernel() {
+        static const CrcKernel selected = selectKernel();
+        return selected;
+    }
+
+} // namespace
+
+namespace crc32c {
+
+    uint32_t compute(const void* data, size_t num_bytes, uint32_t crc) {
+        return ~kernel()(~crc, static_cast<const uint8_t*>(data), num_bytes);
+    }
+
+    uint32_t computeSoftware(const void* data, size_t num_bytes, uint32_t crc) {
+        return ~crcSliceBy8(~crc, static_cast<const uint8_t*>(data), num_bytes);
+    }
+
+    bool isHardwareAccelerated() {
+        return kernel() != crcSliceBy8;
+    }
+
+} // namespace crc32c
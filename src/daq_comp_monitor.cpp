@@ -28,35 +28,27 @@ void DaqCompMonitor::clear() {
     std::fill(cpu_temp_.begin(), cpu_temp_.end(), 0);
 }
 
-std::vector<uint32_t> DaqCompMonitor::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Reserve space for efficiency
-    serialized_data.reserve(num_members_ + NUM_CPUS);
-
-    // Serialize the histogram metadata
-    auto data = Serializer<DaqCompMonitor>::serialize_tuple(member_tuple());
-    serialized_data.insert(serialized_data.end(), data.begin(), data.end());
-    // Charge channel number of samples data
-    serialized_data.insert(serialized_data.end(), cpu_temp_.begin(), cpu_temp_.end());
-    return serialized_data;
+std::array<uint32_t, DaqCompMonitor::kWireWords> DaqCompMonitor::serialize_array() const {
+    static_assert(Layout::matches<decltype(member_tuple()), decltype(cpu_temp_)>(),
+                  "DaqCompMonitor wire layout does not match its members");
+    std::array<uint32_t, kWireWords> words{};
+    // Serialize the metadata followed by the CPU temperatures
+    auto it = Serializer<DaqCompMonitor>::pack_tuple(member_tuple(), words.begin());
+    Serializer<DaqCompMonitor>::pack_arrays(it, cpu_temp_);
+    return words;
 }
 
-std::vector<uint32_t>::const_iterator DaqCompMonitor::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                            std::vector<uint32_t>::const_iterator end) {
-
-    auto it = begin;
-    it = Serializer<DaqCompMonitor>::deserialize_tuple(member_tuple(), begin, end);
-
-    // Ensure there's enough data for the bins
-    if (static_cast<size_t>(std::distance(it, end)) < NUM_CPUS) {
-        throw std::runtime_error("Deserialization failed: not enough data for number CPUs.");
-    }
+void DaqCompMonitor::serialize_into(std::vector<uint32_t>& out) const {
+    auto words = serialize_array();
+    out.insert(out.end(), words.begin(), words.end());
+}
 
-    // Copy num charge samples data
-    std::copy(it, it + NUM_CPUS, cpu_temp_.begin());
-    it += NUM_CPUS;
+const uint32_t* DaqCompMonitor::deserialize(const uint32_t* begin, const uint32_t* end) {
 
-    return it;
+    // Fixed size so one bounds check covers every field
+    requireWords(begin, end, kWireWords, "DaqCompMonitor");
+    auto it = Serializer<DaqCompMonitor>::unpack_tuple(member_tuple(), begin);
+    return Serializer<DaqCompMonitor>::unpack_arrays(it, cpu_temp_);
 }
 
 #ifdef USE_PYTHON
@@ -0,0 +1,249 @@
+//
+// A whole charge or light event in one metric, every channel sharing one header.
+//
+
+#include "../include/event_block.h"
+#include <stdexcept>
+#include <iostream>
+
+namespace {
+
+    constexpr size_t kMaskBits = 32;
+
+    bool isFixedSize(SamplePacking packing) {
+        return packing == SamplePacking::k16Bit || packing == SamplePacking::k12Bit;
+    }
+
+} // namespace
+
+EventBlock::EventBlock(size_t num_channels) : num_channels_(num_channels), run_number_(0), file_number_(0),
+                                              evt_number_(0), format_(0), num_words_(0),
+                                              channel_mask_((num_channels + kMaskBits - 1) / kMaskBits, 0),
+                                              next_channel_(0) {}
+
+void EventBlock::clear() {
+    run_number_ = 0;
+    file_number_ = 0;
+    evt_number_ = 0;
+    format_ = 0;
+    num_words_ = 0;
+    std::fill(channel_mask_.begin(), channel_mask_.end(), 0);
+    // Keep the capacity, the next event is most likely the same size
+    payload_.clear();
+    next_channel_ = 0;
+}
+
+void EventBlock::begin(size_t num_samples, SamplePacking packing) {
+    if (!isFixedSize(packing)) {
+        throw std::invalid_argument("EventBlock supports only the 16-bit and 12-bit packings, got " +
+                                    std::to_string(static_cast<int>(packing)));
+    }
+    if (num_samples > kSamplesMask) {
+        throw std::invalid_argument("EventBlock too many samples per channel " + std::to_string(num_samples));
+    }
+    format_ = (static_cast<uint32_t>(packing) << kPackingShift) | static_cast<uint32_t>(num_samples);
+    num_words_ = 0;
+    std::fill(channel_mask_.begin(), channel_mask_.end(), 0);
+    payload_.clear();
+    next_channel_ = 0;
+}
+
+void EventBlock::checkChannel(size_t channel) const {
+    if (channel >= num_channels_) {
+        throw std::out_of_range("EventBlock channel " + std::to_string(channel) + " out of range, " +
+                                std::to_string(num_channels_) + " channels");
+    }
+}
+
+void EventBlock::packChannel(const uint32_t* samples, size_t num_samples, uint32_t* words) {
+    if (getPacking() == SamplePacking::k16Bit) {
+        sample_packing::packDoubleWords(samples, num_samples, words);
+        return;
+    }
+    // The 12-bit packer writes into a vector, reuse one so a steady stream of events doesn't allocate
+    sample_packing::pack(SamplePacking::k12Bit, samples, num_samples, pack_scratch_);
+    std::copy(pack_scratch_.begin(), pack_scratch_.end(), words);
+}
+
+void EventBlock::addChannel(size_t channel, const uint32_t* samples, size_t num_samples) {
+    checkChannel(channel);
+    if (channel < next_channel_) {
+        throw std::invalid_argument("EventBlock channels must be added in increasing order, got " +
+                                    std::to_string(channel) + " after " + std::to_string(next_channel_ - 1));
+    }
+    if (num_samples != getNumSamples()) {
+        throw std::invalid_argument("EventBlock channel " + std::to_string(channel) + " has " +
+                                    std::to_string(num_samples) + " samples, expected " +
+                                    std::to_string(getNumSamples()));
+    }
+    const size_t offset = payload_.size();
+    payload_.resize(offset + channelWords());
+    uint32_t* words = payload_.data() + offset;
+    packChannel(samples, num_samples, words);
+    channel_mask_[channel / kMaskBits] |= 1u << (channel % kMaskBits);
+    num_words_ = static_cast<uint32_t>(payload_.size());
+    next_channel_ = channel + 1;
+}
+
+void EventBlock::addChannelPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+    checkChannel(channel);
+    if (getPacking() != SamplePacking::k16Bit) {
+        throw std::invalid_argument("EventBlock packed channels need the 16-bit packing");
+    }
+    if (channel < next_channel_ || num_samples != getNumSamples()) {
+        throw std::invalid_argument("EventBlock channel " + std::to_string(channel) + " with " +
+                                    std::to_string(num_samples) + " samples does not follow channel " +
+                                    std::to_string(next_channel_) + " with " + std::to_string(getNumSamples()));
+    }
+    const size_t num_words = channelWords();
+    payload_.insert(payload_.end(), words, words + num_words);
+    // Odd sample counts leave padding in the upper half of the last word, keep it zero
+    if (num_samples & 1) payload_.back() &= 0xFFFF;
+    channel_mask_[channel / kMaskBits] |= 1u << (channel % kMaskBits);
+    num_words_ = static_cast<uint32_t>(payload_.size());
+    next_channel_ = channel + 1;
+}
+
+void EventBlock::setSamples(const uint32_t* samples, size_t num_samples, SamplePacking packing) {
+    begin(num_samples, packing);
+    const size_t channel_words = channelWords();
+    payload_.resize(num_channels_ * channel_words);
+    for (size_t ch = 0; ch < num_channels_; ch++) {
+        const uint32_t* channel_samples = samples + ch * num_samples;
+        packChannel(channel_samples, num_samples, payload_.data() + ch * channel_words);
+    }
+    for (size_t ch = 0; ch < num_channels_; ch++) channel_mask_[ch / kMaskBits] |= 1u << (ch % kMaskBits);
+    num_words_ = static_cast<uint32_t>(payload_.size());
+    next_channel_ = num_channels_;
+}
+
+bool EventBlock::hasChannel(size_t channel) const {
+    checkChannel(channel);
+    return (channel_mask_[channel / kMaskBits] >> (channel % kMaskBits)) & 1;
+}
+
+size_t EventBlock::getNumPresentChannels() const {
+    size_t count = 0;
+    for (uint32_t word : channel_mask_) count += __builtin_popcount(word);
+    return count;
+}
+
+std::vector<uint32_t> EventBlock::getChannels() const {
+    std::vector<uint32_t> channels;
+    channels.reserve(getNumPresentChannels());
+    for (size_t ch = 0; ch < num_channels_; ch++) {
+        if (hasChannel(ch)) channels.push_back(static_cast<uint32_t>(ch));
+    }
+    return channels;
+}
+
+std::vector<uint32_t> EventBlock::getChannelSamples(size_t channel) const {
+    if (!hasChannel(channel)) {
+        throw std::out_of_range("EventBlock channel " + std::to_string(channel) + " is not in the event");
+    }
+    // Rank of the channel among the present ones gives its payload row
+    size_t row = 0;
+    for (size_t w = 0; w < channel / kMaskBits; w++) row += __builtin_popcount(channel_mask_[w]);
+    row += __builtin_popcount(channel_mask_[channel / kMaskBits] & ((1u << (channel % kMaskBits)) - 1));
+    const size_t channel_words = channelWords();
+    std::vector<uint32_t> samples(getNumSamples() + 1);
+    sample_packing::unpack(getPacking(), payload_.data() + row * channel_words, channel_words, samples.data());
+    samples.resize(getNumSamples());
+    return samples;
+}
+
+void EventBlock::unpackAll(uint32_t* samples) const {
+    const size_t num_samples = getNumSamples();
+    const size_t channel_words = channelWords();
+    const size_t num_rows = channel_words == 0 ? 0 : payload_.size() / channel_words;
+    for (size_t row = 0; row < num_rows; row++) {
+        const uint32_t* words = payload_.data() + row * channel_words;
+        uint32_t* dest = samples + row * num_samples;
+        if (getPacking() == SamplePacking::k16Bit && (num_samples & 1)) {
+            // The last word holds a single sample, don't spill its padding into the next row
+            sample_packing::unpackDoubleWords(words, channel_words - 1, dest);
+            dest[num_samples - 1] = words[channel_words - 1] & 0xFFFF;
+        } else {
+            sample_packing::unpack(getPacking(), words, channel_words, dest);
+        }
+    }
+}
+
+void EventBlock::serialize_into(std::vector<uint32_t>& out) const {
+    static_assert(std::tuple_size_v<decltype(member_tuple())> == num_members_,
+                  "EventBlock num_members_ does not match member_tuple()");
+    out.reserve(out.size() + num_members_ + channel_mask_.size() + payload_.size());
+    Serializer<EventBlock>::serialize_tuple_into(member_tuple(), out);
+    out.insert(out.end(), channel_mask_.begin(), channel_mask_.end());
+    out.insert(out.end(), payload_.begin(), payload_.end());
+}
+
+const uint32_t* EventBlock::deserialize(const uint32_t* begin, const uint32_t* end) {
+    auto it = Serializer<EventBlock>::deserialize_tuple(member_tuple(), begin, end);
+    if (!sample_packing::isValid(static_cast<uint8_t>(format_ >> kPackingShift)) || !isFixedSize(getPacking())) {
+        throw std::runtime_error("Deserialization failed: EventBlock packing " +
+                                 std::to_string(format_ >> kPackingShift) + " is not supported");
+    }
+    requireWords(it, end, channel_mask_.size(), "EventBlock channel mask");
+    std::copy(it, it + channel_mask_.size(), channel_mask_.begin());
+    it += channel_mask_.size();
+    const size_t spare_bits = channel_mask_.size() * kMaskBits - num_channels_;
+    if (spare_bits > 0 && (channel_mask_.back() >> (kMaskBits - spare_bits)) != 0) {
+        throw std::runtime_error("Deserialization failed: EventBlock mask has channels beyond " +
+                                 std::to_string(num_channels_));
+    }
+
+    const size_t expected_words = getNumPresentChannels() * channelWords();
+    if (num_words_ != expected_words) {
+        throw std::runtime_error("Deserialization failed: EventBlock payload of " + std::to_string(num_words_) +
+                                 " words does not match " + std::to_string(expected_words) + " for its channels");
+    }
+    requireWords(it, end, num_words_, "EventBlock payload");
+    if (getPacking() == SamplePacking::k12Bit) {
+        // Rows are unpacked by their own sample count, which must match the block's or a row
+        // of the same word size could claim more samples than the caller's buffer holds
+        const size_t channel_words = channelWords();
+        for (size_t offset = 0; offset < num_words_; offset += channel_words) {
+            if (it[offset] != getNumSamples()) {
+                throw std::runtime_error("Deserialization failed: EventBlock 12-bit row of " + std::to_string(it[offset]) +
+                                         " samples, expected " + std::to_string(getNumSamples()));
+            }
+        }
+    }
+    payload_.assign(it, it + num_words_);
+    it += num_words_;
+    // No more channels can be appended to a received event
+    next_channel_ = num_channels_;
+    return it;
+}
+
+#ifdef USE_PYTHON
+py::dict EventBlock::getMetricDict() {
+
+    py::dict metric_dict;
+    metric_dict["run_number"] = run_number_;
+    metric_dict["file_number"] = file_number_;
+    metric_dict["evt_number"] = evt_number_;
+    metric_dict["packing"] = static_cast<int>(getPacking());
+    metric_dict["channels"] = vector_to_numpy_array_1d(getChannels());
+    // Unpack straight into one 2D array, no per-channel objects
+    py::array_t<uint32_t> samples(std::vector<py::ssize_t>{static_cast<py::ssize_t>(getNumPresentChannels()),
+                                                           static_cast<py::ssize_t>(getNumSamples())});
+    unpackAll(samples.mutable_data());
+    metric_dict["samples"] = samples;
+
+    return metric_dict;
+}
+#endif
+
+void EventBlock::print() {
+    std::cout << "++++++++++++ EventBlock +++++++++++++" << std::endl;
+    std::cout << "  run_number: " << run_number_ << std::endl;
+    std::cout << "  file_number: " << file_number_ << std::endl;
+    std::cout << "  evt_number: " << evt_number_ << std::endl;
+    std::cout << "  Packing: " << static_cast<int>(getPacking()) << std::endl;
+    std::cout << "  Channels: " << getNumPresentChannels() << " of " << num_channels_ << std::endl;
+    std::cout << "  Samples per channel: " << getNumSamples() << std::endl;
+    std::cout << "  Payload words: " << num_words_ << std::endl;
+    std::cout << "++++++++++++++++++++++++++++++++++++++++++++" << std::endl;
+}
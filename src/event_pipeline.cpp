@@ -0,0 +1,122 @@
+//
+// Single pass from raw event buffers to the monitor metrics.
+//
+
+#include "../include/event_pipeline.h"
+
+using namespace constants::tpc_readout;
+
+EventPipeline::EventPipeline(TpcMonitor* monitor, LbwStatsEngine* lbw_stats)
+    : decoder_([this](const DecodedEvent& event) { processEvent(event); }),
+      monitor_(monitor), lbw_stats_(lbw_stats) {}
+
+void EventPipeline::setSnapshots(uint32_t interval, ChargeSnapshotCallback on_charge, LightSnapshotCallback on_light) {
+    snapshot_interval_ = interval;
+    events_to_snapshot_ = 0;
+    on_charge_snapshot_ = std::move(on_charge);
+    on_light_snapshot_ = std::move(on_light);
+}
+
+void EventPipeline::processEvent(const DecodedEvent& event) {
+    // The decoder has already counted the markers, shedding only saves the monitoring work
+    const LoadShedder::Action action = shedder_ ? shedder_->admit() : LoadShedder::Action::kFull;
+    if (action == LoadShedder::Action::kSkip) return;
+    const bool full = action == LoadShedder::Action::kFull;
+
+    bool snapshot = false;
+    if (full && snapshot_interval_ > 0) {
+        // Snapshot the first event and then every interval-th one
+        snapshot = events_to_snapshot_ == 0;
+        events_to_snapshot_ = snapshot ? snapshot_interval_ - 1 : events_to_snapshot_ - 1;
+    }
+    const bool charge_snapshot = snapshot && on_charge_snapshot_;
+    const bool light_snapshot = snapshot && on_light_snapshot_;
+    if (charge_snapshot) {
+        charge_snapshot_.setRunNumber(run_number_);
+        charge_snapshot_.setFileNumber(file_number_);
+        charge_snapshot_.setEvtNumber(event.event_number);
+    }
+    if (light_snapshot) {
+        light_snapshot_.setRunNumber(run_number_);
+        light_snapshot_.setFileNumber(file_number_);
+        light_snapshot_.setEvtNumber(event.event_number);
+    }
+
+    if (collect_) {
+        // Bucket the spans by channel group, charge groups first, filled later by processParallel()
+        const size_t num_charge_tasks = (NUM_CHARGE_CHANNELS + kChannelsPerTask - 1) / kChannelsPerTask;
+        for (const ChannelSpan& span : event.charge_channels) {
+            task_spans_[span.channel / kChannelsPerTask].push_back({span, full});
+        }
+        for (const ChannelSpan& span : event.light_channels) {
+            task_spans_[num_charge_tasks + span.channel / kChannelsPerTask].push_back({span, full});
+        }
+    }
+
+    for (const ChannelSpan& span : event.charge_channels) {
+        if (!collect_) fillCharge(span, full);
+        if (charge_snapshot) {
+            charge_snapshot_.setChannelNumber(span.channel);
+            charge_snapshot_.setChargeSamplesPacked(span.words, (span.num_samples + 1) / 2);
+            on_charge_snapshot_(charge_snapshot_);
+        }
+    }
+    for (const ChannelSpan& span : event.light_channels) {
+        if (!collect_) fillLight(span, full);
+        if (light_snapshot) {
+            light_snapshot_.setChannelNumber(span.channel);
+            light_snapshot_.setLightSamplesPacked(span.words, (span.num_samples + 1) / 2);
+            on_light_snapshot_(light_snapshot_);
+        }
+    }
+
+    if (!full) return;
+    if (collect_) {
+        if (!event.charge_channels.empty()) num_collected_charge_events_++;
+        if (!event.light_channels.empty()) num_collected_light_events_++;
+    } else if (lbw_stats_) {
+        if (!event.charge_channels.empty()) lbw_stats_->finishChargeEvent();
+        if (!event.light_channels.empty()) lbw_stats_->finishLightEvent();
+    }
+}
+
+void EventPipeline::fillCharge(const ChannelSpan& span, bool full) {
+    if (monitor_) monitor_->fillChargeChannelPacked(span.channel, span.words, span.num_samples);
+    if (full && lbw_stats_) lbw_stats_->addChargeChannelPacked(span.channel, span.words, span.num_samples);
+}
+
+void EventPipeline::fillLight(const ChannelSpan& span, bool full) {
+    if (monitor_) monitor_->fillLightChannelPacked(span.channel, span.words, span.num_samples);
+    if (full && lbw_stats_) lbw_stats_->addLightChannelPacked(span.channel, span.words, span.num_samples);
+}
+
+const uint32_t* EventPipeline::processParallel(const uint32_t* begin, const uint32_t* end, TaskPool& pool) {
+    const size_t num_charge_tasks = (NUM_CHARGE_CHANNELS + kChannelsPerTask - 1) / kChannelsPerTask;
+    const size_t num_light_tasks = (NUM_LIGHT_CHANNELS + kChannelsPerTask - 1) / kChannelsPerTask;
+    task_spans_.resize(num_charge_tasks + num_light_tasks);
+    for (auto& spans : task_spans_) spans.clear();
+    num_collected_charge_events_ = 0;
+    num_collected_light_events_ = 0;
+
+    // Back to filling while decoding even if a snapshot callback throws
+    struct Collect {
+        bool& collect;
+        ~Collect() { collect = false; }
+    } collect{collect_};
+    collect_ = true;
+    const uint32_t* consumed = decoder_.decode(begin, end);
+    collect_ = false;
+
+    pool.parallelFor(task_spans_.size(), [this, num_charge_tasks](size_t task) {
+        if (task < num_charge_tasks) {
+            for (const TaskSpan& span : task_spans_[task]) fillCharge(span.span, span.full);
+        } else {
+            for (const TaskSpan& span : task_spans_[task]) fillLight(span.span, span.full);
+        }
+    });
+    if (lbw_stats_) {
+        for (uint32_t i = 0; i < num_collected_charge_events_; i++) lbw_stats_->finishChargeEvent();
+        for (uint32_t i = 0; i < num_collected_light_events_; i++) lbw_stats_->finishLightEvent();
+    }
+    return consumed;
+}
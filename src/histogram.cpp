@@ -6,8 +6,221 @@
 #include <stdexcept>
 #include <iostream>
 #include <cmath>
+#include <numeric>
+#include <cstring>
+#include "../include/cpu_features.h"
 
-Histogram::Histogram() : min_value(0), max_value(1), num_bins(1), bin_width(1.0),
+#ifdef DATAMON_X86_DISPATCH
+    #include <immintrin.h>
+#endif
+
+namespace {
+
+    inline uint32_t slotScalar(const BinIndexer& indexer, uint32_t value, uint32_t range, uint32_t num_bins) {
+        if (value - indexer.getMinValue() < range) return indexer.index(value);
+        return value < indexer.getMinValue() ? num_bins : num_bins + 1;
+    }
+
+    // Count the slots of num_values values a block at a time, compute(first, count, slots) writes
+    // the slots of values [first, first + count)
+    template <typename SlotFn>
+    void countSlots(size_t num_values, uint32_t num_bins, uint32_t* bins, uint32_t& below_range_count,
+                    uint32_t& above_range_count, SlotFn compute) {
+        constexpr size_t kBlock = 256;
+        constexpr size_t kLanes = 4;
+        constexpr size_t kMaxLaneSlots = 64;
+        uint32_t slots[kBlock];
+
+        const size_t num_slots = num_bins + 2;
+        if (num_slots > kMaxLaneSlots) {
+            // Too many bins for the stack sub-histograms, count straight into the bins
+            for (size_t i = 0; i < num_values; i += kBlock) {
+                const size_t block = std::min(kBlock, num_values - i);
+                compute(i, block, slots);
+                for (size_t j = 0; j < block; j++) {
+                    if (slots[j] < num_bins) bins[slots[j]]++;
+                    else if (slots[j] == num_bins) below_range_count++;
+                    else above_range_count++;
+                }
+            }
+            return;
+        }
+
+        // Neighbouring samples mostly land in the same bin, rotate them over independent counters
+        uint32_t counts[kLanes][kMaxLaneSlots];
+        for (auto& lane : counts) std::fill_n(lane, num_slots, 0);
+        for (size_t i = 0; i < num_values; i += kBlock) {
+            const size_t block = std::min(kBlock, num_values - i);
+            compute(i, block, slots);
+            size_t j = 0;
+            for (; j + kLanes <= block; j += kLanes) {
+                counts[0][slots[j]]++;
+                counts[1][slots[j + 1]]++;
+                counts[2][slots[j + 2]]++;
+                counts[3][slots[j + 3]]++;
+            }
+            for (; j < block; j++) counts[0][slots[j]]++;
+        }
+
+        for (size_t b = 0; b < num_slots; b++) {
+            const uint32_t total = counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b];
+            if (b < num_bins) bins[b] += total;
+            else if (b == num_bins) below_range_count += total;
+            else above_range_count += total;
+        }
+    }
+
+#ifdef DATAMON_X86_DISPATCH
+    // Slots of 8 values at once. Requires a 32-bit multiplier, i.e. !usesDivision() and
+    // getMultiplier() <= UINT32_MAX
+    class SlotKernelAvx2 {
+    public:
+        __attribute__((target("avx2")))
+        SlotKernelAvx2(const BinIndexer& indexer, uint32_t range)
+            : bias_(_mm256_set1_epi32(INT32_MIN)),
+              min_value_(_mm256_set1_epi32(static_cast<int32_t>(indexer.getMinValue()))),
+              min_biased_(_mm256_xor_si256(min_value_, bias_)),
+              last_offset_(_mm256_set1_epi32(static_cast<int32_t>(range - 1))),
+              multiplier_(_mm256_set1_epi32(static_cast<int32_t>(indexer.getMultiplier()))),
+              shift_(_mm_cvtsi32_si128(static_cast<int>(indexer.getShift()))),
+              below_slot_(_mm256_set1_epi32(static_cast<int32_t>(indexer.getNumBins()))),
+              above_slot_(_mm256_set1_epi32(static_cast<int32_t>(indexer.getNumBins() + 1))) {}
+
+        __attribute__((target("avx2")))
+        __m256i operator()(__m256i value) const {
+            const __m256i offset = _mm256_sub_epi32(value, min_value_);
+            // Unsigned offset < range, values below min wrap around to large offsets
+            const __m256i in_range = _mm256_cmpeq_epi32(_mm256_min_epu32(offset, last_offset_), offset);
+            const __m256i below = _mm256_cmpgt_epi32(min_biased_, _mm256_xor_si256(value, bias_));
+            // 32x32->64 multiplies on the even and odd lanes, then shift down to the bin index
+            const __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(offset, multiplier_), shift_);
+            const __m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(offset, 32), multiplier_), shift_);
+            const __m256i index = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+            const __m256i outside = _mm256_blendv_epi8(above_slot_, below_slot_, below);
+            return _mm256_blendv_epi8(outside, index, in_range);
+        }
+
+    private:
+        __m256i bias_;
+        __m256i min_value_;
+        __m256i min_biased_;
+        __m256i last_offset_;
+        __m256i multiplier_;
+        __m128i shift_;
+        __m256i below_slot_;
+        __m256i above_slot_;
+    };
+
+    __attribute__((target("avx2")))
+    size_t slotsAvx2(const BinIndexer& indexer, uint32_t range, const uint32_t* values, size_t num_values,
+                     uint32_t* slots) {
+        const SlotKernelAvx2 kernel(indexer, range);
+        size_t i = 0;
+        for (; i + 8 <= num_values; i += 8) {
+            const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(slots + i), kernel(value));
+        }
+        return i;
+    }
+
+    // The slots of the lower halves of 8 words are followed by those of the upper halves
+    __attribute__((target("avx2")))
+    size_t packedSlotsAvx2(const BinIndexer& indexer, uint32_t range, const uint32_t* words, size_t num_words,
+                           uint32_t* slots) {
+        const SlotKernelAvx2 kernel(indexer, range);
+        const __m256i low_mask = _mm256_set1_epi32(0xFFFF);
+        size_t i = 0;
+        for (; i + 8 <= num_words; i += 8) {
+            const __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+            auto* out = reinterpret_cast<__m256i*>(slots + 2 * i);
+            _mm256_storeu_si256(out, kernel(_mm256_and_si256(packed, low_mask)));
+            _mm256_storeu_si256(out + 1, kernel(_mm256_srli_epi32(packed, 16)));
+        }
+        return i;
+    }
+#endif
+
+#ifdef DATAMON_X86_DISPATCH
+    __attribute__((target("avx2")))
+    size_t addCountsAvx2(uint32_t* dest, const uint32_t* src, size_t num_counts) {
+        size_t i = 0;
+        for (; i + 8 <= num_counts; i += 8) {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_add_epi32(a, b));
+        }
+        return i;
+    }
+#endif
+
+    // dest[i] += src[i], dest and src may be the same array
+    void addCounts(uint32_t* dest, const uint32_t* src, size_t num_counts) {
+        size_t i = 0;
+#ifdef DATAMON_X86_DISPATCH
+        if (cpu_features::hasAvx2()) i = addCountsAvx2(dest, src, num_counts);
+#endif
+        for (; i < num_counts; i++) dest[i] += src[i];
+    }
+
+    std::string binningString(uint32_t min, uint32_t max, uint32_t num_bins) {
+        return "[" + std::to_string(min) + ", " + std::to_string(max) + ") in " + std::to_string(num_bins) + " bins";
+    }
+
+} // namespace
+
+BinIndexer::BinIndexer(uint32_t min_value, uint32_t max_value, uint32_t num_bins)
+    : min_value_(min_value), range_(max_value - min_value), num_bins_(num_bins), numerator_(num_bins),
+      denominator_(max_value - min_value), multiplier_(0), shift_(0), divide_(true) {
+    const uint64_t divisor = std::gcd(numerator_, denominator_);
+    numerator_ /= divisor;
+    denominator_ /= divisor;
+
+    // floor(x * numerator / denominator) for x < range. With M = ceil(2^S / denominator) and
+    // e = M * denominator - 2^S, floor(x * numerator * M / 2^S) is exact whenever
+    // x * numerator * e < 2^S, and a power-of-two denominator gives e = 0.
+    const uint64_t range = max_value - min_value;
+    const uint64_t max_product = range * numerator_;  // exclusive bound on x * numerator
+    for (uint32_t shift = 0; shift < 64; shift++) {
+        const uint64_t pow2 = uint64_t{1} << shift;
+        const uint64_t reciprocal = pow2 / denominator_ + (pow2 % denominator_ != 0);
+        const uint64_t error = reciprocal * denominator_ - pow2;
+        if (reciprocal > UINT64_MAX / numerator_) break;
+        const uint64_t multiplier = reciprocal * numerator_;
+        if (error <= (pow2 - 1) / max_product && multiplier <= UINT64_MAX / range) {
+            multiplier_ = multiplier;
+            shift_ = shift;
+            divide_ = false;
+            break;
+        }
+    }
+}
+
+void BinIndexer::slots(const uint32_t* values, size_t num_values, uint32_t* slots) const {
+    size_t i = 0;
+#ifdef DATAMON_X86_DISPATCH
+    if (!divide_ && multiplier_ <= UINT32_MAX && cpu_features::hasAvx2()) {
+        i = slotsAvx2(*this, range_, values, num_values, slots);
+    }
+#endif
+    for (; i < num_values; i++) {
+        slots[i] = slotScalar(*this, values[i], range_, num_bins_);
+    }
+}
+
+void BinIndexer::packedSlots(const uint32_t* words, size_t num_words, uint32_t* slots) const {
+    size_t i = 0;
+#ifdef DATAMON_X86_DISPATCH
+    if (!divide_ && multiplier_ <= UINT32_MAX && cpu_features::hasAvx2()) {
+        i = packedSlotsAvx2(*this, range_, words, num_words, slots);
+    }
+#endif
+    for (; i < num_words; i++) {
+        slots[2 * i] = slotScalar(*this, words[i] & 0xFFFF, range_, num_bins_);
+        slots[2 * i + 1] = slotScalar(*this, words[i] >> 16, range_, num_bins_);
+    }
+}
+
+Histogram::Histogram() : min_value(0), max_value(1), num_bins(1), bin_width(1.0), indexer(0, 1, 1),
                          below_range_count(0), above_range_count(0) {
     bins.resize(num_bins, 0);
 }
@@ -23,19 +236,30 @@ Histogram::Histogram(uint32_t min, uint32_t max, uint32_t bins_count)
     }
     bins.resize(num_bins, 0);
     bin_width = static_cast<double>(max_value - min_value) / num_bins;
+    indexer = BinIndexer(min_value, max_value, num_bins);
 }
 
-void Histogram::fill(uint32_t value) {
-    if (value < min_value) {
-        below_range_count++;
-    } else if (value >= max_value) {
-        above_range_count++;
-    } else {
-        int bin_index = static_cast<int>(std::floor((value - min_value) / bin_width));
-        if (bin_index >= 0 && bin_index < num_bins) {
-            bins[bin_index]++;
-        }
+void Histogram::fill(const uint32_t* values, size_t num_values) {
+    countSlots(num_values, num_bins, bins.data(), below_range_count, above_range_count,
+               [&](size_t first, size_t count, uint32_t* slots) { indexer.slots(values + first, count, slots); });
+}
+
+void Histogram::fillPacked(const uint32_t* words, size_t num_samples) {
+    // Blocks hold whole words, an odd last sample is filled on its own
+    const size_t num_paired = num_samples & ~size_t{1};
+    countSlots(num_paired, num_bins, bins.data(), below_range_count, above_range_count,
+               [&](size_t first, size_t count, uint32_t* slots) { indexer.packedSlots(words + first / 2, count / 2, slots); });
+    if (num_samples != num_paired) fill(words[num_samples / 2] & 0xFFFF);
+}
+
+void Histogram::merge(const Histogram& other) {
+    if (min_value != other.min_value || max_value != other.max_value || num_bins != other.num_bins) {
+        throw std::invalid_argument("Histogram merge failed: binning " + binningString(other.min_value, other.max_value, other.num_bins) +
+                                    " does not match " + binningString(min_value, max_value, num_bins));
     }
+    addCounts(bins.data(), other.bins.data(), num_bins);
+    below_range_count += other.below_range_count;
+    above_range_count += other.above_range_count;
 }
 
 void Histogram::clear() {
@@ -44,21 +268,16 @@ void Histogram::clear() {
     above_range_count = 0;
 }
 
-std::vector<uint32_t> Histogram::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Reserve space for efficiency
-    serialized_data.reserve(num_members_ + bins.size());
-
+void Histogram::serialize_into(std::vector<uint32_t>& out) const {
+    static_assert(std::tuple_size_v<decltype(member_tuple())> == num_members_,
+                  "Histogram num_members_ does not match member_tuple()");
     // Serialize the histogram metadata
-    auto data = Serializer<Histogram>::serialize_tuple(member_tuple());
-    serialized_data.insert(serialized_data.end(), data.begin(), data.end());
+    Serializer<Histogram>::serialize_tuple_into(member_tuple(), out);
     // Bin data
-    serialized_data.insert(serialized_data.end(), bins.begin(), bins.end());
-    return serialized_data;
+    out.insert(out.end(), bins.begin(), bins.end());
 }
 
-std::vector<uint32_t>::const_iterator Histogram::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                            std::vector<uint32_t>::const_iterator end) {
+const uint32_t* Histogram::deserialize(const uint32_t* begin, const uint32_t* end) {
     auto it = begin;
     it = Serializer<Histogram>::deserialize_tuple(member_tuple(), begin, end);
 
@@ -68,6 +287,7 @@ std::vector<uint32_t>::const_iterator Histogram::deserialize(std::vector<uint32_
     }
     bins.resize(num_bins);
     bin_width = static_cast<double>(max_value - min_value) / num_bins;
+    indexer = BinIndexer(min_value, max_value, num_bins);
 
     // Ensure there's enough data for the bins
     if (static_cast<size_t>(std::distance(it, end)) < bins.size()) {
@@ -107,4 +327,146 @@ void Histogram::print() const {
     }
     std::cout << "Values above range: " << above_range_count << std::endl;
     std::cout << "-----------------" << std::endl;
-}
\ No newline at end of file
+}
+
+HistogramBlock::HistogramBlock(size_t num_channels, uint32_t min, uint32_t max, uint32_t bins_count)
+    : num_channels_(num_channels), min_value_(0), max_value_(0), num_bins_(0), row_stride_(0), counter_stride_(0) {
+    configure(min, max, bins_count);
+}
+
+void HistogramBlock::configure(uint32_t min, uint32_t max, uint32_t bins_count) {
+    if (max <= min) {
+        throw std::invalid_argument("max_value must be greater than min_value.");
+    }
+    if (bins_count == 0) {
+        throw std::invalid_argument("Number of bins must be positive.");
+    }
+    constexpr size_t kLineWords = kCacheLineSize / sizeof(uint32_t);
+    const auto round_up = [](size_t words) { return (words + kLineWords - 1) / kLineWords * kLineWords; };
+    min_value_ = min;
+    max_value_ = max;
+    num_bins_ = bins_count;
+    row_stride_ = round_up(num_bins_);
+    counter_stride_ = round_up(num_channels_);
+    indexer_ = BinIndexer(min_value_, max_value_, num_bins_);
+    storage_.assign(num_channels_ * row_stride_ + 2 * counter_stride_, 0);
+}
+
+void HistogramBlock::fill(size_t channel, const uint32_t* values, size_t num_values) {
+    checkChannel(channel);
+    countSlots(num_values, num_bins_, row(channel), belowCounts()[channel], aboveCounts()[channel],
+               [&](size_t first, size_t count, uint32_t* slots) { indexer_.slots(values + first, count, slots); });
+}
+
+void HistogramBlock::fillPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+    checkChannel(channel);
+    const size_t num_paired = num_samples & ~size_t{1};
+    countSlots(num_paired, num_bins_, row(channel), belowCounts()[channel], aboveCounts()[channel],
+               [&](size_t first, size_t count, uint32_t* slots) { indexer_.packedSlots(words + first / 2, count / 2, slots); });
+    if (num_samples != num_paired) fill(channel, words[num_samples / 2] & 0xFFFF);
+}
+
+void HistogramBlock::merge(const HistogramBlock& other) {
+    if (num_channels_ != other.num_channels_) {
+        throw std::invalid_argument("HistogramBlock merge failed: " + std::to_string(other.num_channels_) +
+                                    " channels do not match " + std::to_string(num_channels_));
+    }
+    if (min_value_ != other.min_value_ || max_value_ != other.max_value_ || num_bins_ != other.num_bins_) {
+        throw std::invalid_argument("HistogramBlock merge failed: binning " +
+                                    binningString(other.min_value_, other.max_value_, other.num_bins_) +
+                                    " does not match " + binningString(min_value_, max_value_, num_bins_));
+    }
+    // Same binning means the same layout, padding words are zero on both sides
+    addCounts(storage_.data(), other.storage_.data(), storage_.size());
+}
+
+void HistogramBlock::clear() {
+    std::memset(storage_.data(), 0, storage_.size() * sizeof(uint32_t));
+}
+
+uint64_t HistogramBlock::getEntries(size_t channel) const {
+    checkChannel(channel);
+    const uint32_t* bins = row(channel);
+    return std::accumulate(bins, bins + num_bins_, uint64_t{belowCounts()[channel]} + aboveCounts()[channel]);
+}
+
+HistogramView HistogramBlock::view(size_t channel) const {
+    checkChannel(channel);
+    return HistogramView(*this, channel);
+}
+
+std::vector<HistogramView> HistogramBlock::views() const {
+    std::vector<HistogramView> channel_views;
+    channel_views.reserve(num_channels_);
+    for (size_t ch = 0; ch < num_channels_; ch++) channel_views.emplace_back(*this, ch);
+    return channel_views;
+}
+
+void HistogramBlock::serialize_into(std::vector<uint32_t>& out) const {
+    const size_t start = out.size();
+    out.resize(start + serializedWords());
+    uint32_t* dest = out.data() + start;
+    for (size_t ch = 0; ch < num_channels_; ch++) {
+        // Same layout as Histogram::serialize_into()
+        dest[0] = min_value_;
+        dest[1] = max_value_;
+        dest[2] = num_bins_;
+        dest[3] = belowCounts()[ch];
+        dest[4] = aboveCounts()[ch];
+        std::memcpy(dest + kHeaderWords, row(ch), num_bins_ * sizeof(uint32_t));
+        dest += kHeaderWords + num_bins_;
+    }
+}
+
+const uint32_t* HistogramBlock::deserialize(const uint32_t* begin, const uint32_t* end) {
+    auto it = begin;
+    for (size_t ch = 0; ch < num_channels_; ch++) {
+        MetricBase::requireWords(it, end, kHeaderWords, "Histogram metadata");
+        const uint32_t min = it[0];
+        const uint32_t max = it[1];
+        const uint32_t bins_count = it[2];
+        if (max <= min || bins_count == 0) {
+            throw std::runtime_error("Deserialization failed: invalid histogram parameters.");
+        }
+        if (min != min_value_ || max != max_value_ || bins_count != num_bins_) {
+            if (ch != 0) {
+                throw std::runtime_error("Deserialization failed: histogram [" + std::to_string(ch) +
+                                         "] binning differs from the rest of the block.");
+            }
+            // Every channel shares this binning, make sure the whole block is there before
+            // allocating for it so a corrupt bin count fails here instead of in the allocator
+            MetricBase::requireWords(it, end, num_channels_ * (kHeaderWords + static_cast<size_t>(bins_count)),
+                                     "Histogram block");
+            configure(min, max, bins_count);
+        }
+        MetricBase::requireWords(it + kHeaderWords, end, num_bins_, "Histogram bins");
+        belowCounts()[ch] = it[3];
+        aboveCounts()[ch] = it[4];
+        std::memcpy(row(ch), it + kHeaderWords, num_bins_ * sizeof(uint32_t));
+        it += kHeaderWords + num_bins_;
+    }
+    return it;
+}
+
+Histogram HistogramView::toHistogram() const {
+    std::vector<uint32_t> words;
+    words.reserve(5 + getNumBins());
+    words.insert(words.end(), {getMinValue(), getMaxValue(), getNumBins(), getBelowRangeCount(), getAboveRangeCount()});
+    words.insert(words.end(), getBins(), getBins() + getNumBins());
+    Histogram hist;
+    hist.deserialize(words);
+    return hist;
+}
+
+#ifdef USE_PYTHON
+py::dict HistogramView::getMetricDict() const {
+    py::dict metric_dict;
+    metric_dict["min_value"] = getMinValue();
+    metric_dict["max_value"] = getMaxValue();
+    metric_dict["num_bins"] = getNumBins();
+    metric_dict["below_range_count"] = getBelowRangeCount();
+    metric_dict["above_range_count"] = getAboveRangeCount();
+    metric_dict["bins"] = py::array_t<uint32_t>(getNumBins(), getBins());
+    return metric_dict;
+}
+#endif
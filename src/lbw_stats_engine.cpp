@@ -0,0 +1,279 @@
+//
+// Per-channel baseline, RMS and hit counts computed from full events for the LowBwTpcMonitor.
+//
+
+#include "../include/lbw_stats_engine.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "../include/cpu_features.h"
+
+#ifdef DATAMON_X86_DISPATCH
+    #include <immintrin.h>
+#endif
+
+namespace {
+
+    // Samples above this can't be 16-bit ADC words and never enter the baseline
+    constexpr uint32_t kMaxSample = 0xFFFF;
+
+    // Unpacked waveform of the packed entry points, per thread so different channels can be added concurrently
+    thread_local std::vector<uint32_t> tls_scratch;
+
+    struct ClippedSums {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t sum_squares = 0;
+    };
+
+    // State of the excursion count, carried from one chunk of samples to the next
+    struct Excursions {
+        uint32_t count = 0;
+        bool outside = false;
+    };
+
+    void clippedSumsScalar(const uint32_t* samples, size_t num_samples, uint32_t lo, uint32_t hi, ClippedSums& sums) {
+        for (size_t i = 0; i < num_samples; i++) {
+            const uint32_t v = samples[i];
+            const bool in = v >= lo && v <= hi;
+            sums.count += in;
+            sums.sum += in ? v : 0;
+            sums.sum_squares += in ? static_cast<uint64_t>(v) * v : 0;
+        }
+    }
+
+    void excursionsScalar(const uint32_t* samples, size_t num_samples, uint32_t lo, uint32_t hi, Excursions& state) {
+        for (size_t i = 0; i < num_samples; i++) {
+            const bool outside = samples[i] < lo || samples[i] > hi;
+            state.count += outside && !state.outside;
+            state.outside = outside;
+        }
+    }
+
+#ifdef DATAMON_X86_DISPATCH
+    // Lanes of 8 samples with lo <= v <= hi set to all ones
+    __attribute__((target("avx2")))
+    inline __m256i inWindowAvx2(__m256i v, __m256i lo, __m256i hi) {
+        return _mm256_cmpeq_epi32(_mm256_min_epu32(_mm256_max_epu32(v, lo), hi), v);
+    }
+
+    __attribute__((target("avx2")))
+    size_t clippedSumsAvx2(const uint32_t* samples, size_t num_samples, uint32_t lo, uint32_t hi, ClippedSums& sums) {
+        const __m256i lo_v = _mm256_set1_epi32(static_cast<int32_t>(lo));
+        const __m256i hi_v = _mm256_set1_epi32(static_cast<int32_t>(hi));
+        const __m256i low_half = _mm256_set1_epi64x(0xFFFFFFFF);
+        __m256i count = _mm256_setzero_si256();
+        __m256i sum = _mm256_setzero_si256();
+        __m256i sum_squares = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= num_samples; i += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+            const __m256i in = inWindowAvx2(v, lo_v, hi_v);
+            const __m256i kept = _mm256_and_si256(v, in);
+            count = _mm256_sub_epi32(count, in);
+            // 32-bit samples to 64-bit lane sums, even samples sit in the low halves
+            const __m256i even = _mm256_and_si256(kept, low_half);
+            const __m256i odd = _mm256_srli_epi64(kept, 32);
+            sum = _mm256_add_epi64(sum, _mm256_add_epi64(even, odd));
+            sum_squares = _mm256_add_epi64(sum_squares, _mm256_add_epi64(_mm256_mul_epu32(even, even),
+                                                                         _mm256_mul_epu32(odd, odd)));
+        }
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+        sums.sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum_squares);
+        sums.sum_squares += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        alignas(32) uint32_t counts[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(counts), count);
+        for (uint32_t c : counts) sums.count += c;
+        return i;
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    size_t excursionsAvx2(const uint32_t* samples, size_t num_samples, uint32_t lo, uint32_t hi, Excursions& state) {
+        const __m256i lo_v = _mm256_set1_epi32(static_cast<int32_t>(lo));
+        const __m256i hi_v = _mm256_set1_epi32(static_cast<int32_t>(hi));
+        uint32_t previous = state.outside;
+        uint32_t count = 0;
+        size_t i = 0;
+        for (; i + 8 <= num_samples; i += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+            const __m256i in = inWindowAvx2(v, lo_v, hi_v);
+            // One bit per sample outside the window, an excursion starts where a bit follows a clear one
+            const uint32_t outside = ~static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(in))) & 0xFF;
+            count += _mm_popcnt_u32(outside & ~((outside << 1) | previous));
+            previous = outside >> 7;
+        }
+        state.count += count;
+        state.outside = previous;
+        return i;
+    }
+#endif
+
+    ClippedSums clippedSums(const uint32_t* samples, size_t num_samples, uint32_t lo, uint32_t hi) {
+        ClippedSums sums;
+        size_t i = 0;
+#ifdef DATAMON_X86_DISPATCH
+        if (cpu_features::hasAvx2()) i = clippedSumsAvx2(samples, num_samples, lo, hi, sums);
+#endif
+        clippedSumsScalar(samples + i, num_samples - i, lo, hi, sums);
+        return sums;
+    }
+
+    uint32_t countExcursions(const uint32_t* samples, size_t num_samples, uint32_t lo, uint32_t hi) {
+        Excursions state;
+        size_t i = 0;
+#ifdef DATAMON_X86_DISPATCH
+        if (cpu_features::hasAvx2()) i = excursionsAvx2(samples, num_samples, lo, hi, state);
+#endif
+        excursionsScalar(samples + i, num_samples - i, lo, hi, state);
+        return state.count;
+    }
+
+    // Rounded and saturated to the 16-bit monitor fields
+    uint32_t toField(double value) {
+        return static_cast<uint32_t>(std::clamp(std::round(value), 0.0, static_cast<double>(kMaxSample)));
+    }
+
+} // namespace
+
+LbwStatsEngine::LbwStatsEngine(const LbwStatsConfig& config)
+    : config_(config), charge_sums_(NUM_CHARGE_CHANNELS), light_sums_(NUM_LIGHT_CHANNELS) {
+    if (!(config_.clip_sigma > 0.0)) {
+        throw std::invalid_argument("clip_sigma must be positive.");
+    }
+}
+
+WaveformStats LbwStatsEngine::analyzeWaveform(const uint32_t* samples, size_t num_samples, uint32_t threshold,
+                                              double clip_sigma, uint32_t clip_iterations) {
+    WaveformStats stats;
+    uint32_t lo = 0;
+    uint32_t hi = kMaxSample;
+    for (uint32_t iteration = 0; iteration <= clip_iterations; iteration++) {
+        const ClippedSums sums = clippedSums(samples, num_samples, lo, hi);
+        // A window that lost every sample keeps the previous estimate
+        if (sums.count == 0) break;
+        const double count = static_cast<double>(sums.count);
+        stats.baseline = static_cast<double>(sums.sum) / count;
+        const double variance = static_cast<double>(sums.sum_squares) / count - stats.baseline * stats.baseline;
+        stats.rms = std::sqrt(std::max(variance, 0.0));
+
+        const double window = clip_sigma * stats.rms;
+        const auto next_lo = static_cast<uint32_t>(std::max(std::ceil(stats.baseline - window), 0.0));
+        const auto next_hi = static_cast<uint32_t>(std::min(std::floor(stats.baseline + window), static_cast<double>(kMaxSample)));
+        if (next_lo == lo && next_hi == hi) break;
+        lo = next_lo;
+        hi = next_hi;
+    }
+
+    // Integer samples v < baseline - threshold exactly when v < ceil(baseline - threshold), likewise above
+    const double below = std::ceil(stats.baseline - threshold);
+    const double above = std::floor(stats.baseline + threshold);
+    const uint32_t hit_lo = below > 0.0 ? static_cast<uint32_t>(below) : 0;
+    const uint32_t hit_hi = above < static_cast<double>(UINT32_MAX) ? static_cast<uint32_t>(above) : UINT32_MAX;
+    stats.num_hits = countExcursions(samples, num_samples, hit_lo, hit_hi);
+    return stats;
+}
+
+void LbwStatsEngine::addWaveform(ChannelSums& sums, const uint32_t* samples, size_t num_samples, uint32_t threshold) const {
+    const WaveformStats stats = analyzeWaveform(samples, num_samples, threshold, config_.clip_sigma, config_.clip_iterations);
+    sums.baseline += stats.baseline;
+    sums.rms += stats.rms;
+    sums.num_hits += stats.num_hits;
+}
+
+void LbwStatsEngine::addChargeEvent(const uint32_t* samples, size_t num_samples) {
+    for (size_t ch = 0; ch < charge_sums_.size(); ch++) {
+        addWaveform(charge_sums_[ch], samples + ch * num_samples, num_samples, config_.charge_hit_threshold);
+    }
+    num_charge_events_++;
+}
+
+void LbwStatsEngine::addLightEvent(const uint32_t* samples, size_t num_samples) {
+    for (size_t ch = 0; ch < light_sums_.size(); ch++) {
+        addWaveform(light_sums_[ch], samples + ch * num_samples, num_samples, config_.light_roi_threshold);
+    }
+    num_light_events_++;
+}
+
+void LbwStatsEngine::addChargeEventPacked(const uint32_t* words, size_t num_samples) {
+    const size_t stride = (num_samples + 1) / 2;
+    for (size_t ch = 0; ch < charge_sums_.size(); ch++) addChargeChannelPacked(ch, words + ch * stride, num_samples);
+    finishChargeEvent();
+}
+
+void LbwStatsEngine::addLightEventPacked(const uint32_t* words, size_t num_samples) {
+    const size_t stride = (num_samples + 1) / 2;
+    for (size_t ch = 0; ch < light_sums_.size(); ch++) addLightChannelPacked(ch, words + ch * stride, num_samples);
+    finishLightEvent();
+}
+
+void LbwStatsEngine::addChargeChannelPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+    const size_t num_words = (num_samples + 1) / 2;
+    tls_scratch.resize(2 * num_words);
+    sample_packing::unpackDoubleWords(words, num_words, tls_scratch.data());
+    addWaveform(charge_sums_.at(channel), tls_scratch.data(), num_samples, config_.charge_hit_threshold);
+}
+
+void LbwStatsEngine::addLightChannelPacked(size_t channel, const uint32_t* words, size_t num_samples) {
+    const size_t num_words = (num_samples + 1) / 2;
+    tls_scratch.resize(2 * num_words);
+    sample_packing::unpackDoubleWords(words, num_words, tls_scratch.data());
+    addWaveform(light_sums_.at(channel), tls_scratch.data(), num_samples, config_.light_roi_threshold);
+}
+
+WaveformStats LbwStatsEngine::average(const ChannelSums& sums, uint32_t num_events) {
+    WaveformStats stats;
+    if (num_events == 0) return stats;
+    stats.baseline = sums.baseline / num_events;
+    stats.rms = sums.rms / num_events;
+    stats.num_hits = static_cast<uint32_t>(std::lround(static_cast<double>(sums.num_hits) / num_events));
+    return stats;
+}
+
+WaveformStats LbwStatsEngine::getChargeChannel(size_t channel) const {
+    return average(charge_sums_.at(channel), num_charge_events_);
+}
+
+WaveformStats LbwStatsEngine::getLightChannel(size_t channel) const {
+    return average(light_sums_.at(channel), num_light_events_);
+}
+
+void LbwStatsEngine::publish(LowBwTpcMonitor& monitor) const {
+    std::array<uint32_t, NUM_CHARGE_CHANNELS> charge_baselines{};
+    std::array<uint32_t, NUM_CHARGE_CHANNELS> charge_rms{};
+    std::array<uint32_t, NUM_CHARGE_CHANNELS> charge_hits{};
+    if (num_charge_events_ > 0) {
+        for (size_t ch = 0; ch < NUM_CHARGE_CHANNELS; ch++) {
+            const ChannelSums& sums = charge_sums_[ch];
+            charge_baselines[ch] = toField(sums.baseline / num_charge_events_);
+            charge_rms[ch] = toField(kScale * sums.rms / num_charge_events_);
+            charge_hits[ch] = toField(kScale * static_cast<double>(sums.num_hits) / num_charge_events_);
+        }
+    }
+    monitor.setChargeBaselines(charge_baselines);
+    monitor.setChargeRms(charge_rms);
+    monitor.setAvgNumHits(charge_hits);
+
+    std::array<uint32_t, NUM_LIGHT_CHANNELS> light_baselines{};
+    std::array<uint32_t, NUM_LIGHT_CHANNELS> light_rms{};
+    std::array<uint32_t, NUM_LIGHT_CHANNELS> light_rois{};
+    if (num_light_events_ > 0) {
+        for (size_t ch = 0; ch < NUM_LIGHT_CHANNELS; ch++) {
+            const ChannelSums& sums = light_sums_[ch];
+            light_baselines[ch] = toField(sums.baseline / num_light_events_);
+            light_rms[ch] = toField(kScale * sums.rms / num_light_events_);
+            light_rois[ch] = toField(kScale * static_cast<double>(sums.num_hits) / num_light_events_);
+        }
+    }
+    monitor.setLightBaselines(light_baselines);
+    monitor.setLightRms(light_rms);
+    monitor.setLightAvgNumRois(light_rois);
+}
+
+void LbwStatsEngine::clear() {
+    std::fill(charge_sums_.begin(), charge_sums_.end(), ChannelSums());
+    std::fill(light_sums_.begin(), light_sums_.end(), ChannelSums());
+    num_charge_events_ = 0;
+    num_light_events_ = 0;
+}
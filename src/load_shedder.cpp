@@ -0,0 +1,75 @@
+//
+// Graceful degradation of the monitor pipeline when events arrive faster than it keeps up.
+//
+
+#include "../include/load_shedder.h"
+#include <stdexcept>
+#include <string>
+
+LoadShedder::LoadShedder(const LoadSheddingConfig& config) : config_(config) {
+    if (config_.histogram_only_low >= config_.histogram_only_high || config_.sampled_low >= config_.sampled_high) {
+        throw std::invalid_argument("LoadShedder low watermarks must be below the high ones");
+    }
+    if (config_.histogram_only_high > config_.sampled_high || config_.histogram_only_low > config_.sampled_low) {
+        throw std::invalid_argument("LoadShedder histogram-only watermarks must not exceed the sampled ones");
+    }
+    if (config_.sample_interval == 0) {
+        throw std::invalid_argument("LoadShedder sample_interval must be at least 1, got " +
+                                    std::to_string(config_.sample_interval));
+    }
+}
+
+void LoadShedder::update(size_t queue_depth) {
+    ShedLevel level = level_;
+    // A burst may jump straight from full to sampled and back
+    if (queue_depth >= config_.sampled_high) {
+        level = ShedLevel::kSampled;
+    } else if (queue_depth >= config_.histogram_only_high && level == ShedLevel::kFull) {
+        level = ShedLevel::kHistogramOnly;
+    }
+    if (level == ShedLevel::kSampled && queue_depth <= config_.sampled_low) level = ShedLevel::kHistogramOnly;
+    if (level == ShedLevel::kHistogramOnly && queue_depth <= config_.histogram_only_low) level = ShedLevel::kFull;
+
+    if (level != level_) {
+        num_level_changes_++;
+        // The first event after entering the sampled level is histogrammed
+        since_sample_ = 0;
+        level_ = level;
+    }
+}
+
+LoadShedder::Action LoadShedder::admit() {
+    switch (level_) {
+        case ShedLevel::kFull:
+            num_processed_++;
+            return Action::kFull;
+        case ShedLevel::kHistogramOnly:
+            num_processed_++;
+            num_histogram_only_++;
+            return Action::kHistogramOnly;
+        case ShedLevel::kSampled:
+        default:
+            break;
+    }
+    const bool sample = since_sample_ == 0;
+    since_sample_ = since_sample_ + 1 == config_.sample_interval ? 0 : since_sample_ + 1;
+    if (!sample) {
+        num_skipped_++;
+        return Action::kSkip;
+    }
+    num_processed_++;
+    num_histogram_only_++;
+    return Action::kHistogramOnly;
+}
+
+void LoadShedder::publish(LowBwTpcMonitor& monitor) const {
+    monitor.setNumProcessedEvents(num_processed_);
+    monitor.setNumSkippedEvents(num_skipped_);
+}
+
+void LoadShedder::resetCounters() {
+    num_processed_ = 0;
+    num_histogram_only_ = 0;
+    num_skipped_ = 0;
+    num_level_changes_ = 0;
+}
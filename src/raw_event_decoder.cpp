@@ -0,0 +1,215 @@
+//
+// Decoder of raw XMIT/FEM event buffers into per-channel sample spans.
+//
+
+#include "../include/raw_event_decoder.h"
+#include <algorithm>
+#include "../include/cpu_features.h"
+
+#ifdef DATAMON_X86_DISPATCH
+    #include <immintrin.h>
+#endif
+
+using namespace constants::tpc_readout;
+
+namespace {
+
+    // Sample words hold two 12-bit samples, anything above is a marker or header
+    constexpr uint32_t kMaxSampleWord = (1u << raw_event::kTagShift) - 1;
+
+#ifdef DATAMON_X86_DISPATCH
+    __attribute__((target("avx2")))
+    const uint32_t* findMarkerAvx2(const uint32_t* it, const uint32_t* end) {
+        const __m256i max_sample = _mm256_set1_epi32(kMaxSampleWord);
+        for (; end - it >= 8; it += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+            const __m256i is_sample = _mm256_cmpeq_epi32(_mm256_min_epu32(v, max_sample), v);
+            const uint32_t samples = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(is_sample)));
+            if (samples != 0xFF) return it + __builtin_ctz(~samples);
+        }
+        return it;
+    }
+#endif
+
+    // First word at or after it which is not a sample word, or end
+    const uint32_t* findMarker(const uint32_t* it, const uint32_t* end) {
+#ifdef DATAMON_X86_DISPATCH
+        if (cpu_features::hasAvx2()) {
+            it = findMarkerAvx2(it, end);
+            if (end - it >= 8) return it;
+        }
+#endif
+        while (it != end && *it <= kMaxSampleWord) ++it;
+        return it;
+    }
+
+    // Small and fast generator for the synthetic events
+    struct XorShift32 {
+        uint32_t state;
+        uint32_t next() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+    };
+
+    void appendSyntheticChannel(std::vector<uint32_t>& out, XorShift32& rng, uint32_t channel, size_t num_samples,
+                                uint32_t baseline, uint32_t num_pulses) {
+        out.push_back(raw_event::channelStart(channel));
+        const size_t first = out.size();
+        out.resize(first + (num_samples + 1) / 2, 0);
+        uint32_t* words = out.data() + first;
+
+        size_t pulse_start[4];
+        uint32_t pulse_height[4];
+        num_pulses = std::min<uint32_t>(num_pulses, 4);
+        for (uint32_t p = 0; p < num_pulses; p++) {
+            pulse_start[p] = rng.next() % num_samples;
+            pulse_height[p] = 100 + rng.next() % 400;
+        }
+        for (size_t i = 0; i < num_samples; i++) {
+            // Sum of four uniforms for roughly gaussian noise of a few counts
+            const uint32_t r = rng.next();
+            int32_t value = static_cast<int32_t>(baseline) + static_cast<int32_t>((r & 0xF) + ((r >> 4) & 0xF) +
+                            ((r >> 8) & 0xF) + ((r >> 12) & 0xF)) - 30;
+            for (uint32_t p = 0; p < num_pulses; p++) {
+                if (i >= pulse_start[p] && i < pulse_start[p] + 10) value += static_cast<int32_t>(pulse_height[p]);
+            }
+            const uint32_t sample = static_cast<uint32_t>(std::clamp(value, 0, 0xFFF));
+            words[i / 2] |= sample << (16 * (i & 1));
+        }
+        out.push_back(raw_event::channelEnd(channel, static_cast<uint32_t>(num_samples)));
+    }
+
+} // namespace
+
+void raw_event::appendSyntheticEvent(std::vector<uint32_t>& out, uint32_t event_number, uint32_t seed,
+                                     size_t num_charge_samples, size_t num_light_samples) {
+    XorShift32 rng{seed * 2654435761u + event_number + 1};
+    if (rng.state == 0) rng.state = 1;
+    out.push_back(kEventStartMarker);
+    const size_t num_charge_fems = NUM_CHARGE_CHANNELS / kChargeChannelsPerFem;
+    for (uint32_t slot = 0; slot < num_charge_fems; slot++) {
+        out.push_back(boardHeader(BoardType::kCharge, slot));
+        out.push_back(event_number);
+        for (uint32_t ch = 0; ch < kChargeChannelsPerFem; ch++) {
+            appendSyntheticChannel(out, rng, ch, num_charge_samples, 2000 + 3 * ch, rng.next() % 3);
+        }
+    }
+    // The light FEM reads out every hardware channel, including the unused ones
+    out.push_back(boardHeader(BoardType::kLight, static_cast<uint32_t>(num_charge_fems)));
+    out.push_back(event_number);
+    for (uint32_t ch = 0; ch < TOTAL_LIGHT_CHANNELS; ch++) {
+        appendSyntheticChannel(out, rng, ch, num_light_samples, 3000, rng.next() % 2);
+    }
+    out.push_back(kEventEndMarker);
+}
+
+RawEventDecoder::RawEventDecoder(EventCallback on_event) : on_event_(std::move(on_event)) {
+    event_.charge_channels.reserve(NUM_CHARGE_CHANNELS);
+    event_.light_channels.reserve(TOTAL_LIGHT_CHANNELS);
+}
+
+const uint32_t* RawEventDecoder::decode(const uint32_t* begin, const uint32_t* end) {
+    const uint32_t* it = begin;
+    while (it != end) {
+        if (*it != raw_event::kEventStartMarker) {
+            // Out of sync, skip to the next start marker counting any stray end markers on the way
+            const uint32_t* next = std::find(it, end, raw_event::kEventStartMarker);
+            num_end_markers_ += std::count(it, next, raw_event::kEventEndMarker);
+            num_skipped_words_ += next - it;
+            it = next;
+            continue;
+        }
+
+        const uint32_t* event_end = nullptr;
+        const Status status = parseEvent(it, end, event_end);
+        if (status == Status::kIncomplete) break;
+        num_start_markers_++;
+        if (status == Status::kMalformed) {
+            num_malformed_events_++;
+            num_skipped_words_++;
+            it++;
+            continue;
+        }
+        num_end_markers_++;
+        num_events_++;
+        on_event_(event_);
+        it = event_end;
+    }
+    return it;
+}
+
+RawEventDecoder::Status RawEventDecoder::parseEvent(const uint32_t* begin, const uint32_t* end, const uint32_t*& end_out) {
+    event_.charge_channels.clear();
+    event_.light_channels.clear();
+    event_.begin = begin;
+    bool first_board = true;
+
+    const uint32_t* it = begin + 1;
+    while (true) {
+        if (it == end) return Status::kIncomplete;
+        if (*it == raw_event::kEventEndMarker) {
+            if (first_board) return Status::kMalformed;
+            end_out = event_.end = it + 1;
+            return Status::kComplete;
+        }
+
+        // Board header and event number
+        const uint32_t header = *it;
+        if (raw_event::tag(header) != raw_event::kBoardHeaderTag) return Status::kMalformed;
+        const auto type = static_cast<raw_event::BoardType>((header >> 24) & 0xF);
+        const auto slot = static_cast<uint16_t>((header >> 16) & 0xFF);
+        if (type != raw_event::BoardType::kCharge && type != raw_event::BoardType::kLight) return Status::kMalformed;
+        if (end - it < 2) return Status::kIncomplete;
+        const uint32_t event_number = it[1];
+        if (first_board) {
+            event_.event_number = event_number;
+            first_board = false;
+        } else if (event_number != event_.event_number) {
+            // FEMs out of step with each other
+            return Status::kMalformed;
+        }
+        it += 2;
+
+        // Channel blocks up to the next board header or the end marker
+        while (it != end && raw_event::tag(*it) == raw_event::kChannelStartTag) {
+            const uint32_t channel = *it & raw_event::kChannelMask;
+            const uint32_t* words = it + 1;
+            const uint32_t* channel_end = findMarker(words, end);
+            if (channel_end == end) return Status::kIncomplete;
+            if (raw_event::tag(*channel_end) != raw_event::kChannelEndTag ||
+                (*channel_end & raw_event::kChannelMask) != channel) {
+                return Status::kMalformed;
+            }
+            const size_t num_samples = (*channel_end >> raw_event::kNumSamplesShift) & raw_event::kNumSamplesMask;
+            if ((num_samples + 1) / 2 != static_cast<size_t>(channel_end - words)) return Status::kMalformed;
+            it = channel_end + 1;
+
+            // Channels the hardware reads out but the detector does not use are dropped
+            if (type == raw_event::BoardType::kCharge) {
+                const size_t global = slot * raw_event::kChargeChannelsPerFem + channel;
+                if (channel >= raw_event::kChargeChannelsPerFem) return Status::kMalformed;
+                if (global < NUM_CHARGE_CHANNELS) {
+                    event_.charge_channels.push_back({type, slot, static_cast<uint16_t>(global), words, num_samples});
+                }
+            } else if (channel < NUM_LIGHT_CHANNELS) {
+                event_.light_channels.push_back({type, slot, static_cast<uint16_t>(channel), words, num_samples});
+            }
+        }
+    }
+}
+
+void RawEventDecoder::publish(TpcReadoutMonitor& monitor) const {
+    monitor.setStartMarker(num_start_markers_);
+    monitor.setEndMarker(num_end_markers_);
+}
+
+void RawEventDecoder::resetCounters() {
+    num_start_markers_ = 0;
+    num_end_markers_ = 0;
+    num_events_ = 0;
+    num_malformed_events_ = 0;
+    num_skipped_words_ = 0;
+}
@@ -0,0 +1,173 @@
+//
+// Streaming mean and standard deviation of ADC samples.
+//
+
+#include "../include/running_stats.h"
+#include <algorithm>
+#include "../include/cpu_features.h"
+
+#ifdef DATAMON_X86_DISPATCH
+    #include <immintrin.h>
+#endif
+
+namespace {
+
+    // Samples per block, small enough that count * sum_squares fits 64 bits for 16-bit samples
+    constexpr size_t kBlock = 4096;
+
+    struct BlockSums {
+        uint64_t sum = 0;
+        uint64_t sum_squares = 0;
+        // OR of all values, tells if any reached 2^16
+        uint32_t bits = 0;
+
+        void add(uint32_t value) {
+            sum += value;
+            sum_squares += static_cast<uint64_t>(value) * value;
+            bits |= value;
+        }
+    };
+
+#ifdef DATAMON_X86_DISPATCH
+    // Add 8 values to the 64-bit lane sums, the even values sit in the low halves of the lanes
+    __attribute__((target("avx2")))
+    inline void accumulateAvx2(__m256i values, __m256i& sum, __m256i& sum_squares) {
+        const __m256i even = _mm256_and_si256(values, _mm256_set1_epi64x(0xFFFFFFFF));
+        const __m256i odd = _mm256_srli_epi64(values, 32);
+        sum = _mm256_add_epi64(sum, _mm256_add_epi64(even, odd));
+        sum_squares = _mm256_add_epi64(sum_squares, _mm256_add_epi64(_mm256_mul_epu32(even, even),
+                                                                     _mm256_mul_epu32(odd, odd)));
+    }
+
+    __attribute__((target("avx2")))
+    inline void reduceAvx2(__m256i sum, __m256i sum_squares, BlockSums& sums) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+        sums.sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum_squares);
+        sums.sum_squares += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    __attribute__((target("avx2")))
+    size_t blockSumsAvx2(const uint32_t* values, size_t num_values, BlockSums& sums) {
+        __m256i sum = _mm256_setzero_si256();
+        __m256i sum_squares = _mm256_setzero_si256();
+        __m256i bits = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= num_values; i += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            bits = _mm256_or_si256(bits, v);
+            accumulateAvx2(v, sum, sum_squares);
+        }
+        reduceAvx2(sum, sum_squares, sums);
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), bits);
+        for (uint32_t lane : lanes) sums.bits |= lane;
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    size_t packedBlockSumsAvx2(const uint32_t* words, size_t num_words, BlockSums& sums) {
+        const __m256i low_mask = _mm256_set1_epi32(0xFFFF);
+        __m256i sum = _mm256_setzero_si256();
+        __m256i sum_squares = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= num_words; i += 8) {
+            const __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+            accumulateAvx2(_mm256_and_si256(packed, low_mask), sum, sum_squares);
+            accumulateAvx2(_mm256_srli_epi32(packed, 16), sum, sum_squares);
+        }
+        reduceAvx2(sum, sum_squares, sums);
+        return i;
+    }
+#endif
+
+    BlockSums blockSums(const uint32_t* values, size_t num_values) {
+        BlockSums sums;
+        size_t i = 0;
+#ifdef DATAMON_X86_DISPATCH
+        if (cpu_features::hasAvx2()) i = blockSumsAvx2(values, num_values, sums);
+#endif
+        for (; i < num_values; i++) sums.add(values[i]);
+        return sums;
+    }
+
+    // Sums of the 2 * num_words halves, always below 2^16
+    BlockSums packedBlockSums(const uint32_t* words, size_t num_words) {
+        BlockSums sums;
+        size_t i = 0;
+#ifdef DATAMON_X86_DISPATCH
+        if (cpu_features::hasAvx2()) i = packedBlockSumsAvx2(words, num_words, sums);
+#endif
+        for (; i < num_words; i++) {
+            sums.add(words[i] & 0xFFFF);
+            sums.add(words[i] >> 16);
+        }
+        return sums;
+    }
+
+} // namespace
+
+void RunningStats::add(const uint32_t* values, size_t num_values) {
+    for (size_t i = 0; i < num_values; i += kBlock) {
+        const size_t block = std::min(kBlock, num_values - i);
+        const BlockSums sums = blockSums(values + i, block);
+        if (sums.bits >> 16) {
+            // The integer sums could overflow, take the slow exact route
+            for (size_t j = 0; j < block; j++) add(values[i + j]);
+        } else {
+            mergeBlock(block, sums.sum, sums.sum_squares);
+        }
+    }
+}
+
+void RunningStats::addPacked(const uint32_t* words, size_t num_samples) {
+    const size_t num_words = num_samples / 2;
+    for (size_t i = 0; i < num_words; i += kBlock / 2) {
+        const size_t block = std::min(kBlock / 2, num_words - i);
+        const BlockSums sums = packedBlockSums(words + i, block);
+        mergeBlock(2 * block, sums.sum, sums.sum_squares);
+    }
+    if (num_samples & 1) add(words[num_words] & 0xFFFF);
+}
+
+void RunningStats::mergeBlock(uint64_t count, uint64_t sum, uint64_t sum_squares) {
+    if (count == 0) return;
+    RunningStats block;
+    block.count_ = count;
+    block.mean_ = static_cast<double>(sum) / static_cast<double>(count);
+    // count * sum_squares - sum^2 is exact in 64 bits and never negative
+    block.m2_ = static_cast<double>(count * sum_squares - sum * sum) / static_cast<double>(count);
+    merge(block);
+}
+
+void RunningStats::merge(const RunningStats& other) {
+    if (other.count_ == 0) return;
+    if (count_ == 0) {
+        *this = other;
+        return;
+    }
+    const double count_a = static_cast<double>(count_);
+    const double count_b = static_cast<double>(other.count_);
+    const double total = count_a + count_b;
+    const double delta = other.mean_ - mean_;
+    mean_ += delta * count_b / total;
+    m2_ += other.m2_ + delta * delta * count_a * count_b / total;
+    count_ += other.count_;
+}
+
+RunningStats RunningStats::fromSummary(uint64_t count, double mean, double stddev) {
+    RunningStats stats;
+    if (count == 0) return stats;
+    stats.count_ = count;
+    stats.mean_ = mean;
+    stats.m2_ = stddev * stddev * static_cast<double>(count);
+    return stats;
+}
+
+uint32_t RunningStats::toFixedPoint(double value) {
+    const double scaled = std::round(value * (1u << kFractionBits));
+    if (!(scaled > 0.0)) return 0;
+    if (scaled >= static_cast<double>(UINT32_MAX)) return UINT32_MAX;
+    return static_cast<uint32_t>(scaled);
+}
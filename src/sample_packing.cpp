@@ -0,0 +1,728 @@
+//
+// Packing of ADC waveform samples into 32-bit words for the event metrics.
+//
+
+#include "../include/sample_packing.h"
+#include "../include/cpu_features.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#ifdef DATAMON_X86_DISPATCH
+    #include <immintrin.h>
+#endif
+
+namespace {
+
+    // 8 samples of 12 bits fill exactly 3 words
+    constexpr size_t kGroupSamples = 8;
+    constexpr size_t kGroupWords = 3;
+
+    void pack12Group(const uint32_t* s, uint32_t* w) {
+        const uint32_t m = sample_packing::kAdcMask;
+        w[0] = (s[0] & m) | (s[1] & m) << 12 | (s[2] & m) << 24;
+        w[1] = (s[2] & m) >> 8 | (s[3] & m) << 4 | (s[4] & m) << 16 | (s[5] & m) << 28;
+        w[2] = (s[5] & m) >> 4 | (s[6] & m) << 8 | (s[7] & m) << 20;
+    }
+
+    void unpack12Group(const uint32_t* w, uint32_t* s) {
+        s[0] = w[0] & 0xFFF;
+        s[1] = (w[0] >> 12) & 0xFFF;
+        s[2] = (w[0] >> 24) | (w[1] & 0xF) << 8;
+        s[3] = (w[1] >> 4) & 0xFFF;
+        s[4] = (w[1] >> 16) & 0xFFF;
+        s[5] = (w[1] >> 28) | (w[2] & 0xFF) << 4;
+        s[6] = (w[2] >> 8) & 0xFFF;
+        s[7] = w[2] >> 20;
+    }
+
+    // Whole groups only, the partial group at the end is handled by the caller
+    void pack12Scalar(const uint32_t* samples, size_t num_groups, uint32_t* words) {
+        for (size_t g = 0; g < num_groups; g++) {
+            pack12Group(samples + g * kGroupSamples, words + g * kGroupWords);
+        }
+    }
+
+    void unpack12Scalar(const uint32_t* words, size_t num_groups, uint32_t* samples) {
+        for (size_t g = 0; g < num_groups; g++) {
+            unpack12Group(words + g * kGroupWords, samples + g * kGroupSamples);
+        }
+    }
+
+#ifdef DATAMON_X86_DISPATCH
+    __attribute__((target("ssse3")))
+    void pack12Ssse3(const uint32_t* samples, size_t num_groups, uint32_t* words) {
+        const __m128i adc_mask = _mm_set1_epi32(0xFFF);
+        const __m128i high_mask = _mm_set1_epi32(0xFFF000);
+        // Keep the low 3 bytes of each 32-bit lane
+        const __m128i compact = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        for (size_t g = 0; g < num_groups; g++) {
+            const auto* in = reinterpret_cast<const __m128i*>(samples + g * kGroupSamples);
+            const __m128i lo = _mm_and_si128(_mm_loadu_si128(in), adc_mask);
+            const __m128i hi = _mm_and_si128(_mm_loadu_si128(in + 1), adc_mask);
+            // Pair up samples as 16-bit halves, then squeeze each pair into 24 bits
+            const __m128i pairs = _mm_packs_epi32(lo, hi);
+            const __m128i packed = _mm_or_si128(_mm_and_si128(pairs, adc_mask),
+                                                _mm_and_si128(_mm_srli_epi32(pairs, 4), high_mask));
+            const __m128i bytes = _mm_shuffle_epi8(packed, compact);
+            uint32_t* out = words + g * kGroupWords;
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+            out[2] = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(bytes, 8)));
+        }
+    }
+
+    // Each group is read with a 16 byte load, so the caller must leave one word past the last group
+    __attribute__((target("ssse3")))
+    void unpack12Ssse3(const uint32_t* words, size_t num_groups, uint32_t* samples) {
+        const __m128i adc_mask = _mm_set1_epi32(0xFFF);
+        // Odd samples start half way through a byte and need shifting down by 4
+        const __m128i odd_lanes = _mm_setr_epi32(0, -1, 0, -1);
+        const __m128i spread_lo = _mm_setr_epi8(0, 1, -1, -1, 1, 2, -1, -1, 3, 4, -1, -1, 4, 5, -1, -1);
+        const __m128i spread_hi = _mm_setr_epi8(6, 7, -1, -1, 7, 8, -1, -1, 9, 10, -1, -1, 10, 11, -1, -1);
+        for (size_t g = 0; g < num_groups; g++) {
+            const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + g * kGroupWords));
+            auto* out = reinterpret_cast<__m128i*>(samples + g * kGroupSamples);
+            for (const __m128i& spread : {spread_lo, spread_hi}) {
+                const __m128i lanes = _mm_shuffle_epi8(in, spread);
+                const __m128i aligned = _mm_or_si128(_mm_andnot_si128(odd_lanes, lanes),
+                                                     _mm_and_si128(odd_lanes, _mm_srli_epi32(lanes, 4)));
+                _mm_storeu_si128(out++, _mm_and_si128(aligned, adc_mask));
+            }
+        }
+    }
+#endif
+
+    // Two 16-bit samples per word, whole words only
+    void packDoubleScalar(const uint32_t* samples, size_t num_words, uint32_t* words) {
+        for (size_t i = 0; i < num_words; i++) {
+            words[i] = ((samples[2 * i + 1] & 0xFFFF) << 16) | (samples[2 * i] & 0xFFFF);
+        }
+    }
+
+    void unpackDoubleScalar(const uint32_t* words, size_t num_words, uint32_t* samples) {
+        for (size_t i = 0; i < num_words; i++) {
+            samples[2 * i] = words[i] & 0xFFFF;
+            samples[2 * i + 1] = (words[i] >> 16) & 0xFFFF;
+        }
+    }
+
+#ifdef DATAMON_X86_DISPATCH
+    __attribute__((target("sse2")))
+    void packDoubleSse2(const uint32_t* samples, size_t num_words, uint32_t* words) {
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+        size_t i = 0;
+        for (; i + 4 <= num_words; i += 4) {
+            const __m128i a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + 2 * i)), mask);
+            const __m128i b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + 2 * i + 4)), mask);
+            // Move each odd sample up into the high half of its even neighbour, then keep the even lanes
+            const __m128 pa = _mm_castsi128_ps(_mm_or_si128(a, _mm_srli_epi64(a, 16)));
+            const __m128 pb = _mm_castsi128_ps(_mm_or_si128(b, _mm_srli_epi64(b, 16)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(words + i),
+                             _mm_castps_si128(_mm_shuffle_ps(pa, pb, _MM_SHUFFLE(2, 0, 2, 0))));
+        }
+        packDoubleScalar(samples + 2 * i, num_words - i, words + i);
+    }
+
+    __attribute__((target("sse2")))
+    void unpackDoubleSse2(const uint32_t* words, size_t num_words, uint32_t* samples) {
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+        size_t i = 0;
+        for (; i + 4 <= num_words; i += 4) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+            const __m128i lo = _mm_and_si128(v, mask);
+            const __m128i hi = _mm_srli_epi32(v, 16);
+            auto* out = reinterpret_cast<__m128i*>(samples + 2 * i);
+            _mm_storeu_si128(out, _mm_unpacklo_epi32(lo, hi));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(lo, hi));
+        }
+        unpackDoubleScalar(words + i, num_words - i, samples + 2 * i);
+    }
+
+    __attribute__((target("avx2")))
+    void packDoubleAvx2(const uint32_t* samples, size_t num_words, uint32_t* words) {
+        const __m256i mask = _mm256_set1_epi32(0xFFFF);
+        size_t i = 0;
+        for (; i + 8 <= num_words; i += 8) {
+            const __m256i a = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + 2 * i)), mask);
+            const __m256i b = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + 2 * i + 8)), mask);
+            const __m256 pa = _mm256_castsi256_ps(_mm256_or_si256(a, _mm256_srli_epi64(a, 16)));
+            const __m256 pb = _mm256_castsi256_ps(_mm256_or_si256(b, _mm256_srli_epi64(b, 16)));
+            // The in-lane shuffle leaves words 0,1,4,5 | 2,3,6,7, restore the order across lanes
+            const __m256i packed = _mm256_castps_si256(_mm256_shuffle_ps(pa, pb, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(words + i),
+                                _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        packDoubleScalar(samples + 2 * i, num_words - i, words + i);
+    }
+
+    __attribute__((target("avx2")))
+    void unpackDoubleAvx2(const uint32_t* words, size_t num_words, uint32_t* samples) {
+        const __m256i mask = _mm256_set1_epi32(0xFFFF);
+        size_t i = 0;
+        for (; i + 8 <= num_words; i += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+            const __m256i lo = _mm256_and_si256(v, mask);
+            const __m256i hi = _mm256_srli_epi32(v, 16);
+            // In-lane interleave gives samples 0-3,8-11 and 4-7,12-15, swap the middle lanes back
+            const __m256i a = _mm256_unpacklo_epi32(lo, hi);
+            const __m256i b = _mm256_unpackhi_epi32(lo, hi);
+            auto* out = reinterpret_cast<__m256i*>(samples + 2 * i);
+            _mm256_storeu_si256(out, _mm256_permute2x128_si256(a, b, 0x20));
+            _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(a, b, 0x31));
+        }
+        unpackDoubleScalar(words + i, num_words - i, samples + 2 * i);
+    }
+#endif
+
+    // One bit per sample outside [low, high], the bits past num_samples in the last word are left zero
+    void thresholdMaskScalar(const uint32_t* samples, size_t num_samples, uint32_t low, uint32_t high, uint64_t* mask) {
+        for (size_t w = 0; w * 64 < num_samples; w++) {
+            const size_t end = std::min(num_samples, w * 64 + 64);
+            uint64_t bits = 0;
+            for (size_t i = w * 64; i < end; i++) {
+                bits |= static_cast<uint64_t>(samples[i] < low || samples[i] > high) << (i - w * 64);
+            }
+            mask[w] = bits;
+        }
+    }
+
+#ifdef DATAMON_X86_DISPATCH
+    __attribute__((target("avx2")))
+    void thresholdMaskAvx2(const uint32_t* samples, size_t num_samples, uint32_t low, uint32_t high, uint64_t* mask) {
+        const __m256i lo = _mm256_set1_epi32(static_cast<int32_t>(low));
+        const __m256i hi = _mm256_set1_epi32(static_cast<int32_t>(high));
+        size_t w = 0;
+        for (; w * 64 + 64 <= num_samples; w++) {
+            uint64_t bits = 0;
+            for (size_t v = 0; v < 8; v++) {
+                const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + w * 64 + v * 8));
+                // Unsigned compares by clamping, a sample is inside when clamping leaves it unchanged
+                const __m256i inside = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(x, lo), x),
+                                                        _mm256_cmpeq_epi32(_mm256_min_epu32(x, hi), x));
+                const uint32_t inside_bits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(inside)));
+                bits |= static_cast<uint64_t>(~inside_bits & 0xFF) << (v * 8);
+            }
+            mask[w] = bits;
+        }
+        thresholdMaskScalar(samples + w * 64, num_samples - w * 64, low, high, mask + w);
+    }
+#endif
+
+    using PackKernel = void (*)(const uint32_t*, size_t, uint32_t*);
+    using MaskKernel = void (*)(const uint32_t*, size_t, uint32_t, uint32_t, uint64_t*);
+
+    struct Kernels {
+        PackKernel pack12;
+        PackKernel unpack12;
+        PackKernel pack_double;
+        PackKernel unpack_double;
+        MaskKernel threshold_mask;
+    };
+
+    Kernels selectKernels() {
+        Kernels kernels{pack12Scalar, unpack12Scalar, packDoubleScalar, unpackDoubleScalar, thresholdMaskScalar};
+#ifdef DATAMON_X86_DISPATCH
+        if (cpu_features::hasSse2()) {
+            kernels.pack_double = packDoubleSse2;
+            kernels.unpack_double = unpackDoubleSse2;
+        }
+        if (cpu_features::hasSsse3()) {
+            kernels.pack12 = pack12Ssse3;
+            kernels.unpack12 = unpack12Ssse3;
+        }
+        if (cpu_features::hasAvx2()) {
+            kernels.pack_double = packDoubleAvx2;
+            kernels.unpack_double = unpackDoubleAvx2;
+            kernels.threshold_mask = thresholdMaskAvx2;
+        }
+#endif
+        return kernels;
+    }
+
+    // Chosen on first use so packing is also safe to use during static initialization
+    const Kernels& kernels() {
+        static const Kernels selected = selectKernels();
+        return selected;
+    }
+
+    /*
+     * Rice coding of the sample to sample differences. Each difference is zigzag mapped to an
+     * unsigned value z and written as the unary quotient z >> k (ones closed by a zero) followed
+     * by the k low bits. Quotients of kRiceEscape or more are instead written as kRiceEscape ones
+     * and the raw 12-bit sample, so no symbol is longer than 28 bits. Bits are packed LSB first.
+     */
+    constexpr uint32_t kRiceEscape = 16;
+    constexpr uint32_t kRiceMaxK = 12;
+    constexpr uint32_t kRiceCountBits = 27;
+    constexpr uint32_t kRiceCountMask = (1u << kRiceCountBits) - 1;
+    constexpr uint32_t kRiceMaxSymbolBits = kRiceEscape + 12;
+
+    inline uint32_t zigzag(int32_t value) {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    inline int32_t unzigzag(uint32_t value) {
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+
+    inline uint32_t riceBits(uint32_t z, uint32_t k) {
+        const uint32_t quotient = z >> k;
+        return quotient < kRiceEscape ? quotient + 1 + k : kRiceMaxSymbolBits;
+    }
+
+    size_t riceBoundWords(size_t num_samples) {
+        return (num_samples * kRiceMaxSymbolBits + 31) / 32;
+    }
+
+    // Pick k from the mean residual, then refine by counting the exact size of the neighbours
+    uint32_t chooseRiceK(const uint32_t* samples, size_t num_samples) {
+        uint64_t sum = 0;
+        uint32_t prev = 0;
+        for (size_t i = 0; i < num_samples; i++) {
+            const uint32_t sample = samples[i] & sample_packing::kAdcMask;
+            sum += zigzag(static_cast<int32_t>(sample - prev));
+            prev = sample;
+        }
+        uint32_t estimate = 0;
+        for (uint64_t mean = num_samples > 0 ? sum / num_samples : 0; mean > 1 && estimate < kRiceMaxK; mean >>= 1) {
+            estimate++;
+        }
+
+        // Exact sizes for the estimate and its two neighbours, in one pass
+        const uint32_t first_k = estimate > 0 ? estimate - 1 : 0;
+        uint64_t bits[3] = {0, 0, 0};
+        prev = 0;
+        for (size_t i = 0; i < num_samples; i++) {
+            const uint32_t sample = samples[i] & sample_packing::kAdcMask;
+            const uint32_t z = zigzag(static_cast<int32_t>(sample - prev));
+            for (uint32_t c = 0; c < 3; c++) bits[c] += riceBits(z, std::min(first_k + c, kRiceMaxK));
+            prev = sample;
+        }
+        uint32_t best_k = first_k;
+        uint64_t best_bits = bits[0];
+        for (uint32_t c = 1; c < 3; c++) {
+            if (bits[c] < best_bits) {
+                best_bits = bits[c];
+                best_k = std::min(first_k + c, kRiceMaxK);
+            }
+        }
+        return best_k;
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(uint32_t* out) : out_(out), acc_(0), num_bits_(0) {}
+
+        // Append the low num_bits (at most 32) of value
+        void put(uint64_t value, uint32_t num_bits) {
+            acc_ |= value << num_bits_;
+            num_bits_ += num_bits;
+            if (num_bits_ >= 32) {
+                *out_++ = static_cast<uint32_t>(acc_);
+                acc_ >>= 32;
+                num_bits_ -= 32;
+            }
+        }
+
+        // Write out any partial word, returns the position after the last word
+        uint32_t* flush() {
+            if (num_bits_ > 0) *out_++ = static_cast<uint32_t>(acc_);
+            acc_ = 0;
+            num_bits_ = 0;
+            return out_;
+        }
+
+    private:
+        uint32_t* out_;
+        uint64_t acc_;
+        uint32_t num_bits_;
+    };
+
+    class BitReader {
+    public:
+        BitReader(const uint32_t* begin, const uint32_t* end)
+            : it_(begin), end_(end), acc_(0), num_bits_(0), consumed_bits_(0) {}
+
+        // Guarantee at least 33 buffered bits, reading zeros past the end of the payload
+        void refill() {
+            while (num_bits_ <= 32) {
+                const uint64_t word = it_ != end_ ? *it_++ : 0;
+                acc_ |= word << num_bits_;
+                num_bits_ += 32;
+            }
+        }
+
+        uint64_t peek() const { return acc_; }
+
+        void skip(uint32_t num_bits) {
+            acc_ >>= num_bits;
+            num_bits_ -= num_bits;
+            consumed_bits_ += num_bits;
+        }
+
+        uint64_t consumedBits() const { return consumed_bits_; }
+
+    private:
+        const uint32_t* it_;
+        const uint32_t* end_;
+        uint64_t acc_;
+        uint32_t num_bits_;
+        uint64_t consumed_bits_;
+    };
+
+    inline uint32_t countTrailingOnes(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+        return ~bits == 0 ? 64 : static_cast<uint32_t>(__builtin_ctzll(~bits));
+#else
+        uint32_t count = 0;
+        for (; bits & 1; bits >>= 1) count++;
+        return count;
+#endif
+    }
+
+    // Encode into words, which has room for riceBoundWords(), returns the number of words written
+    size_t riceEncode(const uint32_t* samples, size_t num_samples, uint32_t k, uint32_t* words) {
+        BitWriter writer(words);
+        const uint32_t remainder_mask = (1u << k) - 1;
+        uint32_t prev = 0;
+        for (size_t i = 0; i < num_samples; i++) {
+            const uint32_t sample = samples[i] & sample_packing::kAdcMask;
+            const uint32_t z = zigzag(static_cast<int32_t>(sample - prev));
+            const uint32_t quotient = z >> k;
+            if (quotient < kRiceEscape) {
+                const uint64_t code = ((uint64_t{1} << quotient) - 1) | (static_cast<uint64_t>(z & remainder_mask) << (quotient + 1));
+                writer.put(code, quotient + 1 + k);
+            } else {
+                writer.put(((uint64_t{1} << kRiceEscape) - 1) | (static_cast<uint64_t>(sample) << kRiceEscape),
+                           kRiceMaxSymbolBits);
+            }
+            prev = sample;
+        }
+        return static_cast<size_t>(writer.flush() - words);
+    }
+
+    // Decode the first num_samples samples, check_length also requires the payload to end there
+    void riceDecode(const uint32_t* words, size_t num_words, uint32_t k, uint32_t* samples, size_t num_samples,
+                    bool check_length) {
+        BitReader reader(words, words + num_words);
+        const uint32_t remainder_mask = (1u << k) - 1;
+        int32_t prev = 0;
+        for (size_t i = 0; i < num_samples; i++) {
+            reader.refill();
+            const uint32_t quotient = countTrailingOnes(reader.peek());
+            int32_t sample;
+            if (quotient >= kRiceEscape) {
+                reader.skip(kRiceEscape);
+                sample = static_cast<int32_t>(reader.peek() & sample_packing::kAdcMask);
+                reader.skip(12);
+            } else {
+                reader.skip(quotient + 1);
+                const uint32_t remainder = static_cast<uint32_t>(reader.peek()) & remainder_mask;
+                reader.skip(k);
+                sample = prev + unzigzag((quotient << k) | remainder);
+                if (sample < 0 || sample > static_cast<int32_t>(sample_packing::kAdcMask)) {
+                    throw std::runtime_error("Unpacking failed: Rice coded sample out of the ADC range");
+                }
+            }
+            samples[i] = static_cast<uint32_t>(sample);
+            prev = sample;
+        }
+        const uint64_t words_used = (reader.consumedBits() + 31) / 32;
+        if (words_used > num_words || (check_length && words_used != num_words)) {
+            throw std::runtime_error("Unpacking failed: Rice coded payload of " + std::to_string(num_words) +
+                                     " words does not match its sample count");
+        }
+    }
+
+    size_t packed12Words(size_t num_samples) {
+        return (num_samples * 12 + 31) / 32;
+    }
+
+    void pack12(const uint32_t* samples, size_t num_samples, uint32_t* words) {
+        const size_t num_groups = num_samples / kGroupSamples;
+        kernels().pack12(samples, num_groups, words);
+
+        const size_t tail_samples = num_samples - num_groups * kGroupSamples;
+        if (tail_samples == 0) return;
+        uint32_t group_samples[kGroupSamples] = {};
+        uint32_t group_words[kGroupWords];
+        std::copy_n(samples + num_groups * kGroupSamples, tail_samples, group_samples);
+        pack12Group(group_samples, group_words);
+        std::copy_n(group_words, packed12Words(num_samples) - num_groups * kGroupWords, words + num_groups * kGroupWords);
+    }
+
+    void unpack12(const uint32_t* words, size_t num_samples, uint32_t* samples) {
+        const size_t num_words = packed12Words(num_samples);
+        const size_t num_groups = num_samples / kGroupSamples;
+        // The vector kernel over-reads by one word, stop short of the end of the payload
+        const size_t fast_groups = num_words > kGroupWords ? std::min(num_groups, (num_words - 1) / kGroupWords) : 0;
+        kernels().unpack12(words, fast_groups, samples);
+        unpack12Scalar(words + fast_groups * kGroupWords, num_groups - fast_groups, samples + fast_groups * kGroupSamples);
+
+        const size_t tail_samples = num_samples - num_groups * kGroupSamples;
+        if (tail_samples == 0) return;
+        uint32_t group_words[kGroupWords] = {};
+        uint32_t group_samples[kGroupSamples];
+        std::copy_n(words + num_groups * kGroupWords, num_words - num_groups * kGroupWords, group_words);
+        unpack12Group(group_words, group_samples);
+        std::copy_n(group_samples, tail_samples, samples + num_groups * kGroupSamples);
+    }
+
+    /*
+     * Zero suppressed regions. The header word holds the baseline and sample count, 16 bits each,
+     * every region a header word with its length and start followed by its samples two per word.
+     */
+    constexpr uint32_t kZsFieldBits = 16;
+    constexpr uint32_t kZsFieldMask = (1u << kZsFieldBits) - 1;
+    // A gap of up to two samples costs no more than the header of a new region, so bridge it
+    constexpr size_t kZsMergeGap = 2;
+
+    // Index of the first sample from on whose mask bit equals set, or num_samples if there is none
+    size_t findMaskBit(const uint64_t* mask, size_t from, size_t num_samples, bool set) {
+        if (from >= num_samples) return num_samples;
+        size_t w = from / 64;
+        uint64_t word = (set ? mask[w] : ~mask[w]) & (~uint64_t{0} << (from % 64));
+        while (word == 0) {
+            if (++w * 64 >= num_samples) return num_samples;
+            word = set ? mask[w] : ~mask[w];
+        }
+        return std::min(num_samples, w * 64 + static_cast<size_t>(__builtin_ctzll(word)));
+    }
+
+    /*
+     * Walk the regions of a zero suppressed payload, writing the first limit samples if samples is
+     * not null. Every region is checked, so with limit 0 this only validates the payload.
+     */
+    size_t zsDecode(const uint32_t* words, size_t num_words, uint32_t* samples, size_t limit) {
+        if (num_words == 0) {
+            throw std::runtime_error("Unpacking failed: zero suppressed payload has no header");
+        }
+        const size_t num_samples = words[0] & kZsFieldMask;
+        const uint32_t baseline = words[0] >> kZsFieldBits;
+        if (samples == nullptr) limit = 0;
+        limit = std::min(limit, num_samples);
+
+        size_t next = 0;
+        size_t pos = 1;
+        while (pos < num_words) {
+            const size_t start = words[pos] & kZsFieldMask;
+            const size_t length = words[pos] >> kZsFieldBits;
+            const size_t region_words = (length + 1) / 2;
+            if (length == 0 || start < next || start + length > num_samples || region_words > num_words - pos - 1) {
+                throw std::runtime_error("Unpacking failed: malformed zero suppressed region at word " +
+                                         std::to_string(pos) + " of " + std::to_string(num_words));
+            }
+            if (std::min(next, limit) < std::min(start, limit)) {
+                std::fill(samples + next, samples + std::min(start, limit), baseline);
+            }
+            if (start < limit) {
+                const size_t count = std::min(length, limit - start);
+                const uint32_t* region = words + pos + 1;
+                sample_packing::unpackDoubleWords(region, count / 2, samples + start);
+                if (count % 2 != 0) samples[start + count - 1] = region[count / 2] & 0xFFFF;
+            }
+            next = start + length;
+            pos += 1 + region_words;
+        }
+        if (next < limit) std::fill(samples + next, samples + limit, baseline);
+        return num_samples;
+    }
+
+} // namespace
+
+namespace sample_packing {
+
+    void thresholdMask(const uint32_t* samples, size_t num_samples, uint32_t low, uint32_t high, uint64_t* mask) {
+        kernels().threshold_mask(samples, num_samples, low, high, mask);
+    }
+
+    SamplePacking packZeroSuppressed(const uint32_t* samples, size_t num_samples, uint32_t baseline,
+                                     uint32_t threshold, uint32_t pre_samples, uint32_t post_samples,
+                                     std::vector<uint32_t>& out) {
+        if (num_samples > kZsFieldMask || baseline > kZsFieldMask) {
+            throw std::invalid_argument("Zero suppression needs 16-bit sample counts and baselines, got " +
+                                        std::to_string(num_samples) + " samples at baseline " +
+                                        std::to_string(baseline));
+        }
+        // Reused per thread so a stream of waveforms doesn't allocate
+        thread_local std::vector<uint64_t> mask;
+        mask.resize((num_samples + 63) / 64);
+        const uint32_t low = baseline > threshold ? baseline - threshold : 0;
+        const uint32_t high = threshold > UINT32_MAX - baseline ? UINT32_MAX : baseline + threshold;
+        thresholdMask(samples, num_samples, low, high, mask.data());
+
+        // Only worth it when smaller than the plain 16-bit payload, give up as soon as it isn't
+        const size_t budget = packedWords(SamplePacking::k16Bit, num_samples);
+        out.resize(budget);
+        size_t pos = 1;
+        auto emit = [&](size_t start, size_t end) {
+            const size_t length = end - start;
+            const size_t region_words = 1 + (length + 1) / 2;
+            if (pos + region_words >= budget) return false;
+            out[pos] = static_cast<uint32_t>(length << kZsFieldBits | start);
+            packDoubleWords(samples + start, length, out.data() + pos + 1);
+            pos += region_words;
+            return true;
+        };
+
+        size_t region_start = 0;
+        size_t region_end = 0;
+        bool open = false;
+        for (size_t hit = findMaskBit(mask.data(), 0, num_samples, true); hit < num_samples;) {
+            const size_t hit_end = findMaskBit(mask.data(), hit, num_samples, false);
+            const size_t start = hit > pre_samples ? hit - pre_samples : 0;
+            const size_t end = std::min<size_t>(num_samples, hit_end + post_samples);
+            if (open && start <= region_end + kZsMergeGap) {
+                region_end = std::max(region_end, end);
+            } else {
+                if (open && !emit(region_start, region_end)) return pack(SamplePacking::k16Bit, samples, num_samples, out);
+                region_start = start;
+                region_end = end;
+                open = true;
+            }
+            hit = findMaskBit(mask.data(), hit_end, num_samples, true);
+        }
+        if (open && !emit(region_start, region_end)) return pack(SamplePacking::k16Bit, samples, num_samples, out);
+        if (pos >= budget) return pack(SamplePacking::k16Bit, samples, num_samples, out);
+
+        out[0] = baseline << kZsFieldBits | static_cast<uint32_t>(num_samples);
+        out.resize(pos);
+        return SamplePacking::kZeroSuppressed;
+    }
+
+    void packDoubleWords(const uint32_t* samples, size_t num_samples, uint32_t* words) {
+        kernels().pack_double(samples, num_samples / 2, words);
+        if (num_samples % 2 != 0) words[num_samples / 2] = samples[num_samples - 1] & 0xFFFF;
+    }
+
+    void unpackDoubleWords(const uint32_t* words, size_t num_words, uint32_t* samples) {
+        kernels().unpack_double(words, num_words, samples);
+    }
+
+    size_t unpackHead(SamplePacking packing, const uint32_t* words, size_t num_words, uint32_t* samples,
+                      size_t max_samples) {
+        const size_t num_samples = numSamples(packing, words, num_words);
+        // Round down to whole words / groups so a truncated unpack never reads past the payload
+        switch (packing) {
+            case SamplePacking::k16Bit: {
+                const size_t head_words = std::min(num_words, max_samples / 2);
+                unpackDoubleWords(words, head_words, samples);
+                return 2 * head_words;
+            }
+            case SamplePacking::k12Bit: {
+                const size_t head_samples = std::min(num_samples, max_samples / kGroupSamples * kGroupSamples);
+                unpack12(words + 1, head_samples, samples);
+                return head_samples;
+            }
+            case SamplePacking::kRice: {
+                const size_t head_samples = std::min(num_samples, max_samples);
+                riceDecode(words + 1, num_words - 1, words[0] >> kRiceCountBits, samples, head_samples, false);
+                return head_samples;
+            }
+            case SamplePacking::kZeroSuppressed:
+                zsDecode(words, num_words, samples, max_samples);
+                return std::min(num_samples, max_samples);
+        }
+        return 0;
+    }
+
+    bool isValid(uint8_t packing) {
+        return packing <= static_cast<uint8_t>(SamplePacking::kZeroSuppressed);
+    }
+
+    size_t packedWords(SamplePacking packing, size_t num_samples) {
+        switch (packing) {
+            case SamplePacking::k16Bit: return (num_samples + 1) / 2;
+            case SamplePacking::k12Bit: return 1 + packed12Words(num_samples);
+            case SamplePacking::kRice: return 1 + riceBoundWords(num_samples);
+            // packZeroSuppressed() falls back to k16Bit rather than exceed it
+            case SamplePacking::kZeroSuppressed: return packedWords(SamplePacking::k16Bit, num_samples);
+        }
+        throw std::invalid_argument("Unknown sample packing " + std::to_string(static_cast<int>(packing)));
+    }
+
+    SamplePacking pack(SamplePacking packing, const uint32_t* samples, size_t num_samples, std::vector<uint32_t>& out) {
+        out.resize(packedWords(packing, num_samples));
+        switch (packing) {
+            case SamplePacking::k16Bit:
+                packDoubleWords(samples, num_samples, out.data());
+                break;
+            case SamplePacking::k12Bit:
+                out[0] = static_cast<uint32_t>(num_samples);
+                pack12(samples, num_samples, out.data() + 1);
+                break;
+            case SamplePacking::kRice: {
+                if (num_samples > kRiceCountMask) {
+                    throw std::invalid_argument("Too many samples for the Rice packing " + std::to_string(num_samples));
+                }
+                const uint32_t k = chooseRiceK(samples, num_samples);
+                out[0] = (k << kRiceCountBits) | static_cast<uint32_t>(num_samples);
+                const size_t num_words = 1 + riceEncode(samples, num_samples, k, out.data() + 1);
+                // Noisy waveforms can code larger than the plain 12-bit packing, use that instead
+                if (num_words >= packedWords(SamplePacking::k12Bit, num_samples)) {
+                    return pack(SamplePacking::k12Bit, samples, num_samples, out);
+                }
+                out.resize(num_words);
+                break;
+            }
+            case SamplePacking::kZeroSuppressed:
+                throw std::invalid_argument("Zero suppression needs a baseline and threshold, use packZeroSuppressed()");
+        }
+        return packing;
+    }
+
+    size_t numSamples(SamplePacking packing, const uint32_t* words, size_t num_words) {
+        switch (packing) {
+            case SamplePacking::k16Bit:
+                return 2 * num_words;
+            case SamplePacking::k12Bit:
+                if (num_words == 0 || packedWords(packing, words[0]) != num_words) {
+                    throw std::runtime_error("Unpacking failed: 12-bit payload of " + std::to_string(num_words) +
+                                             " words does not match its sample count");
+                }
+                return words[0];
+            case SamplePacking::kRice: {
+                if (num_words == 0 || (words[0] >> kRiceCountBits) > kRiceMaxK) {
+                    throw std::runtime_error("Unpacking failed: malformed Rice coded payload header");
+                }
+                // Every symbol takes at least k + 1 bits and at most kRiceMaxSymbolBits, so the
+                // count is checked against the payload size before anyone allocates for it
+                const uint64_t count = words[0] & kRiceCountMask;
+                const uint64_t stream_bits = 32 * static_cast<uint64_t>(num_words - 1);
+                if (count * ((words[0] >> kRiceCountBits) + 1) > stream_bits || num_words - 1 > riceBoundWords(count)) {
+                    throw std::runtime_error("Unpacking failed: Rice coded payload of " + std::to_string(num_words) +
+                                             " words cannot hold " + std::to_string(count) + " samples");
+                }
+                return count;
+            }
+            case SamplePacking::kZeroSuppressed:
+                return zsDecode(words, num_words, nullptr, 0);
+        }
+        throw std::runtime_error("Unpacking failed: unknown sample packing " + std::to_string(static_cast<int>(packing)));
+    }
+
+    void unpack(SamplePacking packing, const uint32_t* words, size_t num_words, uint32_t* samples) {
+        const size_t num_samples = numSamples(packing, words, num_words);
+        switch (packing) {
+            case SamplePacking::k16Bit:
+                unpackDoubleWords(words, num_words, samples);
+                break;
+            case SamplePacking::k12Bit:
+                unpack12(words + 1, num_samples, samples);
+                break;
+            case SamplePacking::kRice:
+                riceDecode(words + 1, num_words - 1, words[0] >> kRiceCountBits, samples, num_samples, true);
+                break;
+            case SamplePacking::kZeroSuppressed:
+                zsDecode(words, num_words, samples, num_samples);
+                break;
+        }
+    }
+
+    std::vector<uint32_t> unpack(SamplePacking packing, const std::vector<uint32_t>& words) {
+        std::vector<uint32_t> samples(numSamples(packing, words.data(), words.size()));
+        unpack(packing, words.data(), words.size(), samples.data());
+        return samples;
+    }
+
+} // namespace sample_packing
@@ -0,0 +1,47 @@
+//
+// TpcMonitor filled from several decoder threads at once.
+//
+
+#include "../include/sharded_tpc_monitor.h"
+#include <string>
+#include <thread>
+
+uint32_t ShardedTpcMonitor::Shard::retire() {
+    // Only snapshot() flips the index, pairs with the sequentially consistent accesses in enter()
+    const uint32_t retired = active_.load(std::memory_order_relaxed);
+    active_.store(retired ^ 1, std::memory_order_seq_cst);
+    const uint64_t sequence = sequence_.load(std::memory_order_seq_cst);
+    if (sequence & 1) {
+        // A fill is in progress and may be on the retired monitor, any fill after it uses the new one
+        while (sequence_.load(std::memory_order_acquire) == sequence) std::this_thread::yield();
+    }
+    return retired;
+}
+
+ShardedTpcMonitor::ShardedTpcMonitor(size_t num_shards)
+    : num_shards_(num_shards), shards_(new Shard[num_shards]) {}
+
+ShardedTpcMonitor::Shard& ShardedTpcMonitor::shard(size_t index) {
+    if (index >= num_shards_) {
+        throw std::out_of_range("ShardedTpcMonitor shard [" + std::to_string(index) + "] out of range [" +
+                                std::to_string(num_shards_) + "]");
+    }
+    return shards_[index];
+}
+
+void ShardedTpcMonitor::snapshot(TpcMonitor& out) {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    out.clear();
+    for (size_t i = 0; i < num_shards_; i++) {
+        TpcMonitor& retired = shards_[i].monitors_[shards_[i].retire()];
+        out.merge(retired);
+        // Ready to become the active monitor at the next snapshot
+        retired.clear();
+    }
+}
+
+TpcMonitor ShardedTpcMonitor::snapshot() {
+    TpcMonitor out;
+    snapshot(out);
+    return out;
+}
@@ -0,0 +1,107 @@
+//
+// Small work-stealing thread pool for the parallel event processing.
+//
+
+#include "../include/task_pool.h"
+#include <exception>
+
+namespace {
+
+    // Queue of the worker running on this thread, or none outside the pool
+    thread_local const void* tls_pool = nullptr;
+    thread_local size_t tls_queue = 0;
+
+} // namespace
+
+TaskPool::TaskPool(size_t num_threads) {
+    for (size_t i = 0; i < num_threads + 1; i++) queues_.push_back(std::make_unique<Queue>());
+    threads_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; i++) threads_.emplace_back(&TaskPool::workerLoop, this, i);
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) thread.join();
+}
+
+void TaskPool::submit(Task task) {
+    // Workers keep their own tasks local, outside callers spread theirs over the workers
+    size_t index;
+    if (tls_pool == this) {
+        index = tls_queue;
+    } else {
+        index = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted under the wake mutex so a worker about to sleep can't miss it
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        num_queued_.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake_.notify_one();
+}
+
+bool TaskPool::runOne() {
+    const size_t num_queues = queues_.size();
+    const size_t self = tls_pool == this ? tls_queue : num_queues - 1;
+    Task task;
+    for (size_t i = 0; i < num_queues && !task; i++) {
+        Queue& queue = *queues_[(self + i) % num_queues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (i == 0) {
+            // Newest own task, its data is most likely still in cache
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            // Steal the oldest, typically the biggest remaining piece of someone else's work
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    num_queued_.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void TaskPool::workerLoop(size_t index) {
+    tls_pool = this;
+    tls_queue = index;
+    while (true) {
+        if (runOne()) continue;
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_.wait(lock, [this] { return stop_ || num_queued_.load(std::memory_order_relaxed) > 0; });
+        if (stop_) return;
+    }
+}
+
+void TaskPool::parallelFor(size_t num_tasks, const std::function<void(size_t)>& body) {
+    if (num_tasks == 0) return;
+    std::atomic<size_t> remaining{num_tasks};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    for (size_t i = 0; i < num_tasks; i++) {
+        submit([&, i] {
+            try {
+                body(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+    // Help out until our tasks are done, they may be running elsewhere when the queues run dry
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (!runOne()) std::this_thread::yield();
+    }
+    if (error) std::rethrow_exception(error);
+}
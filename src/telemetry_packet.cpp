@@ -0,0 +1,141 @@
+//
+// Framed telemetry packets holding several serialized metrics.
+//
+
+#include "../include/telemetry_packet.h"
+#include "../include/daq_comp_monitor.h"
+#include "../include/tpc_readout_monitor.h"
+#include "../include/tpc_monitor.h"
+#include "../include/tpc_monitor_lbw.h"
+#include "../include/tpc_monitor_query.h"
+#include "../include/tpc_monitor_charge_event.h"
+#include "../include/tpc_monitor_light_event.h"
+#include "../include/event_block.h"
+#include <stdexcept>
+
+MetricRegistry::MetricRegistry() : table_(kNumSlots) {}
+
+void MetricRegistry::add(uint16_t code, Factory factory) {
+    Entry& entry = table_[slot(code)];
+    if (entry.factory != nullptr && entry.code != code) {
+        throw std::invalid_argument("Telemetry code " + std::to_string(code) +
+                                    " collides with registered code " + std::to_string(entry.code));
+    }
+    entry.code = code;
+    entry.factory = factory;
+}
+
+const MetricRegistry& MetricRegistry::defaults() {
+    static const MetricRegistry registry = [] {
+        MetricRegistry reg;
+        reg.add<DaqCompMonitor>(TelemetryCodes::ORC_Hardware_Status);
+        reg.add<TpcReadoutMonitor>(TelemetryCodes::TPC_Hardware_Status);
+        reg.add<LowBwTpcMonitor>(TelemetryCodes::TPCMonitor_LB_Data);
+        reg.add<TpcMonitor>(TelemetryCodes::TPCMonitor_Histograms);
+        reg.add<TpcMonitorChargeEvent>(TelemetryCodes::TPCMonitor_Charge_Event);
+        reg.add<TpcMonitorLightEvent>(TelemetryCodes::TPCMonitor_Light_Event);
+        reg.add<TpcMonitorQuery>(TelemetryCodes::TPCMonitor_Query);
+        reg.add<ChargeEventBlock>(TelemetryCodes::TPCMonitor_Charge_Event_Block);
+        reg.add<LightEventBlock>(TelemetryCodes::TPCMonitor_Light_Event_Block);
+        return reg;
+    }();
+    return registry;
+}
+
+void TelemetryPacketEncoder::begin() {
+    frame_.clear();
+    frame_.resize(TelemetryPacket::kFrameHeaderWords, 0);
+    num_records_ = 0;
+}
+
+uint32_t TelemetryPacketEncoder::add(TelemetryCodes code, const MetricBase& metric, uint8_t flags) {
+    if (num_records_ >= TelemetryPacket::kMaxRecords) {
+        throw std::length_error("Telemetry frame is full, maximum records " +
+                                std::to_string(TelemetryPacket::kMaxRecords));
+    }
+    // Leave room for the record header and back-fill the length once the payload is written
+    const size_t header_pos = frame_.size();
+    frame_.resize(header_pos + TelemetryPacket::kRecordHeaderWords);
+    if (flags & TelemetryPacket::kFlagCrc32c) {
+        metric.serialize_into_with_crc(frame_);
+    } else {
+        metric.serialize_into(frame_);
+    }
+
+    RecordHeader header;
+    header.code = pgrams::communication::to_telem_u16(code);
+    header.flags = flags;
+    header.num_words = static_cast<uint32_t>(frame_.size() - header_pos - TelemetryPacket::kRecordHeaderWords);
+    header.sequence = sequence_++;
+    header.pack(frame_.data() + header_pos);
+    num_records_++;
+    return header.sequence;
+}
+
+const std::vector<uint32_t>& TelemetryPacketEncoder::finish() {
+    frame_[0] = (TelemetryPacket::kFrameMagic << 16) | static_cast<uint32_t>(num_records_);
+    frame_[1] = static_cast<uint32_t>(frame_.size() - TelemetryPacket::kFrameHeaderWords);
+    return frame_;
+}
+
+std::unique_ptr<MetricBase> TelemetryPacketDecoder::decodeRecord(const RecordHeader& header,
+                                                                 const uint32_t* payload) const {
+    if (header.version > TelemetryPacket::kFormatVersion) {
+        throw std::runtime_error("Decoding failed: record format version " + std::to_string(header.version) +
+                                 " is newer than supported version " +
+                                 std::to_string(TelemetryPacket::kFormatVersion));
+    }
+    const uint32_t* payload_end = payload + header.num_words;
+    if (header.flags & TelemetryPacket::kFlagCrc32c) {
+        if (header.num_words == 0) {
+            throw std::runtime_error("Decoding failed: record with code " + std::to_string(header.code) +
+                                     " is flagged with a CRC32C trailer but has no payload");
+        }
+        payload_end--;
+        MetricBase::verifyCrc(payload, payload_end, *payload_end);
+    }
+
+    auto metric = registry_.create(header.code);
+    if (!metric) return nullptr;
+
+    if (metric->deserialize(payload, payload_end) != payload_end) {
+        throw std::runtime_error("Decoding failed: record with code " + std::to_string(header.code) +
+                                 " did not consume its " + std::to_string(payload_end - payload) + " words");
+    }
+    return metric;
+}
+
+const uint32_t* TelemetryPacketDecoder::decode(const uint32_t* begin, const uint32_t* end,
+                                               std::vector<DecodedMetric>& metrics) const {
+    MetricBase::requireWords(begin, end, TelemetryPacket::kFrameHeaderWords, "TelemetryPacket frame header");
+    if (!TelemetryPacket::isFrameStart(begin[0])) {
+        throw std::runtime_error("Decoding failed: missing telemetry frame magic");
+    }
+    const size_t num_records = begin[0] & 0xFFFF;
+    const size_t frame_words = begin[1];
+
+    const uint32_t* it = begin + TelemetryPacket::kFrameHeaderWords;
+    MetricBase::requireWords(it, end, frame_words, "TelemetryPacket frame");
+    const uint32_t* frame_end = it + frame_words;
+
+    for (size_t i = 0; i < num_records; i++) {
+        MetricBase::requireWords(it, frame_end, TelemetryPacket::kRecordHeaderWords, "TelemetryPacket record header");
+        DecodedMetric decoded;
+        decoded.header = RecordHeader::unpack(it);
+        it += TelemetryPacket::kRecordHeaderWords;
+        MetricBase::requireWords(it, frame_end, decoded.header.num_words, "TelemetryPacket record");
+        decoded.metric = decodeRecord(decoded.header, it);
+        it += decoded.header.num_words;
+        metrics.push_back(std::move(decoded));
+    }
+    if (it != frame_end) {
+        throw std::runtime_error("Decoding failed: frame length does not match its records");
+    }
+    return frame_end;
+}
+
+std::vector<DecodedMetric> TelemetryPacketDecoder::decode(const std::vector<uint32_t>& frame) const {
+    std::vector<DecodedMetric> metrics;
+    decode(frame.data(), frame.data() + frame.size(), metrics);
+    return metrics;
+}
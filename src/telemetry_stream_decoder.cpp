@@ -0,0 +1,266 @@
+//
+// Incremental decoder for a byte stream of concatenated telemetry frames.
+//
+
+#include "../include/telemetry_stream_decoder.h"
+#include <cstring>
+
+TelemetryStreamDecoder::TelemetryStreamDecoder(MetricCallback on_metric, size_t max_record_words,
+                                               const MetricRegistry& registry)
+    : on_metric_(std::move(on_metric)), decoder_(registry), max_record_words_(max_record_words),
+      state_(State::kSeekFrame), window_(0), window_bytes_(0), partial_word_(0), partial_bytes_(0),
+      records_left_(0), frame_words_left_(0), header_words_{}, header_words_received_(0),
+      payload_received_(0), frame_header_(0), frame_begin_(0), history_lost_(0), corrupted_(false),
+      stream_offset_(0), skipped_bytes_(0), total_skipped_bytes_(0), num_frames_(0),
+      num_metrics_(0), num_unknown_records_(0), num_resyncs_(0), num_corrupt_frames_(0) {
+    // The only buffers the decoder needs, allocated once up front
+    payload_.resize(max_record_words_);
+    const size_t history_bytes = (max_record_words_ + TelemetryPacket::kFrameHeaderWords +
+                                  TelemetryPacket::kRecordHeaderWords) * sizeof(uint32_t);
+    history_.reserve(history_bytes);
+    rescan_.reserve(history_bytes);
+}
+
+void TelemetryStreamDecoder::reset() {
+    state_ = State::kSeekFrame;
+    window_ = 0;
+    window_bytes_ = 0;
+    partial_word_ = 0;
+    partial_bytes_ = 0;
+    records_left_ = 0;
+    frame_words_left_ = 0;
+    header_words_received_ = 0;
+    payload_received_ = 0;
+    history_.clear();
+    history_lost_ = 0;
+    corrupted_ = false;
+    total_skipped_bytes_ += skipped_bytes_;
+    skipped_bytes_ = 0;
+}
+
+void TelemetryStreamDecoder::feed(const uint8_t* data, size_t num_bytes) {
+    size_t i = 0;
+    for (;;) {
+        scan(data, num_bytes, i);
+        if (!corrupted_) return;
+        // Search the bad frame again from just past its header, the start of the next frame may be inside it
+        beginRescan(i - frame_begin_);
+        i = frame_begin_;
+        // Bytes kept from earlier chunks come first, then the rest of this one
+        rescan_.swap(history_);
+        history_.clear();
+        rescanHistory();
+    }
+}
+
+void TelemetryStreamDecoder::beginRescan(size_t buffer_bytes) {
+    corrupted_ = false;
+    num_corrupt_frames_++;
+    // The consumed bytes of the bad frame are searched again, so they no longer count as read
+    stream_offset_ -= buffer_bytes + history_.size();
+    // The frame header is skipped, the rest of the frame is counted as it is searched
+    skipped_bytes_ = sizeof(uint32_t) + history_lost_;
+    if (history_lost_ == 0) {
+        // A magic could start within the frame header word itself
+        window_ = frame_header_ >> 8;
+        window_bytes_ = sizeof(uint32_t) - 1;
+    }
+    history_lost_ = 0;
+}
+
+void TelemetryStreamDecoder::rescanHistory() {
+    size_t j = 0;
+    for (;;) {
+        scan(rescan_.data(), rescan_.size(), j);
+        if (!corrupted_) break;
+        // A frame found in the history went bad before the history ran out, so all of its bytes
+        // are in rescan_ and none were kept in history_
+        beginRescan(j - frame_begin_);
+        j = frame_begin_;
+    }
+    rescan_.clear();
+}
+
+void TelemetryStreamDecoder::keepHistory(const uint8_t* data, size_t num_bytes) {
+    // Only the last bytes of a frame longer than the history are kept, the rest are skipped unsearched
+    const size_t capacity = history_.capacity();
+    if (num_bytes >= capacity) {
+        history_lost_ += history_.size() + num_bytes - capacity;
+        history_.assign(data + num_bytes - capacity, data + num_bytes);
+        return;
+    }
+    if (history_.size() + num_bytes > capacity) {
+        const size_t excess = history_.size() + num_bytes - capacity;
+        history_lost_ += excess;
+        history_.erase(history_.begin(), history_.begin() + static_cast<std::ptrdiff_t>(excess));
+    }
+    history_.insert(history_.end(), data, data + num_bytes);
+}
+
+void TelemetryStreamDecoder::scan(const uint8_t* data, size_t num_bytes, size_t& pos) {
+    size_t i = pos;
+    // A frame already locked onto continues from here, its earlier bytes are in the history
+    frame_begin_ = i;
+    while (i < num_bytes && !corrupted_) {
+        if (state_ == State::kSeekFrame) {
+            // Slide a one word window over the bytes until it lines up with a frame header
+            window_ = (window_ >> 8) | (static_cast<uint32_t>(data[i++]) << 24);
+            stream_offset_++;
+            skipped_bytes_++;
+            if (++window_bytes_ < sizeof(uint32_t) || !TelemetryPacket::isFrameStart(window_)) continue;
+
+            skipped_bytes_ -= sizeof(uint32_t);
+            if (skipped_bytes_ > 0) {
+                num_resyncs_++;
+                total_skipped_bytes_ += skipped_bytes_;
+                if (on_resync_) on_resync_({stream_offset_ - sizeof(uint32_t), skipped_bytes_});
+            }
+            skipped_bytes_ = 0;
+            window_bytes_ = 0;
+            frame_header_ = window_;
+            frame_begin_ = i;
+            records_left_ = window_ & 0xFFFF;
+            state_ = State::kFrameLength;
+            continue;
+        }
+        if (state_ == State::kPayload && partial_bytes_ == 0) {
+            const size_t words_available = (num_bytes - i) / sizeof(uint32_t);
+            const size_t words_needed = header_.num_words - payload_received_;
+            const bool aligned = reinterpret_cast<uintptr_t>(data + i) % alignof(uint32_t) == 0;
+            // The whole record is in this chunk, decode it where it lies
+            if (payload_received_ == 0 && aligned && words_available >= words_needed) {
+                const size_t num_payload_bytes = words_needed * sizeof(uint32_t);
+                const auto* payload = reinterpret_cast<const uint32_t*>(data + i);
+                i += num_payload_bytes;
+                stream_offset_ += num_payload_bytes;
+                frame_words_left_ -= words_needed;
+                if (emitRecord(payload)) finishRecord();
+                continue;
+            }
+            // Otherwise copy as many whole words as we have into the record buffer
+            const size_t num_words = std::min(words_available, words_needed);
+            if (num_words > 0) {
+                std::memcpy(payload_.data() + payload_received_, data + i, num_words * sizeof(uint32_t));
+                i += num_words * sizeof(uint32_t);
+                stream_offset_ += num_words * sizeof(uint32_t);
+                payload_received_ += num_words;
+                frame_words_left_ -= num_words;
+                if (payload_received_ == header_.num_words && emitRecord(payload_.data())) finishRecord();
+                continue;
+            }
+        }
+
+        // Assemble the next word a byte at a time, it may straddle two chunks
+        partial_word_ |= static_cast<uint32_t>(data[i++]) << (8 * partial_bytes_);
+        stream_offset_++;
+        if (++partial_bytes_ == sizeof(uint32_t)) {
+            const uint32_t word = partial_word_;
+            partial_word_ = 0;
+            partial_bytes_ = 0;
+            consumeWord(word);
+        }
+    }
+    pos = i;
+    // Keep the bytes of an unfinished frame in case it turns out bad in a later chunk
+    if (!corrupted_ && state_ != State::kSeekFrame) keepHistory(data + frame_begin_, i - frame_begin_);
+}
+
+void TelemetryStreamDecoder::consumeWord(uint32_t word) {
+    switch (state_) {
+        case State::kFrameLength:
+            frame_words_left_ = word;
+            if (records_left_ * TelemetryPacket::kRecordHeaderWords > frame_words_left_) {
+                corrupt();
+            } else if (records_left_ == 0) {
+                if (frame_words_left_ != 0) {
+                    corrupt();
+                    return;
+                }
+                endFrame();
+            } else {
+                header_words_received_ = 0;
+                state_ = State::kRecordHeader;
+            }
+            break;
+
+        case State::kRecordHeader:
+            header_words_[header_words_received_++] = word;
+            frame_words_left_--;
+            if (header_words_received_ < TelemetryPacket::kRecordHeaderWords) return;
+
+            header_ = RecordHeader::unpack(header_words_.data());
+            if (header_.num_words > max_record_words_ || header_.num_words > frame_words_left_ ||
+                header_.version > TelemetryPacket::kFormatVersion) {
+                corrupt();
+                return;
+            }
+            payload_received_ = 0;
+            if (header_.num_words == 0) {
+                if (emitRecord(payload_.data())) finishRecord();
+            } else {
+                state_ = State::kPayload;
+            }
+            break;
+
+        case State::kPayload:
+            payload_[payload_received_++] = word;
+            frame_words_left_--;
+            if (payload_received_ == header_.num_words && emitRecord(payload_.data())) finishRecord();
+            break;
+
+        case State::kSeekFrame:
+            break;
+    }
+}
+
+bool TelemetryStreamDecoder::emitRecord(const uint32_t* payload) {
+    std::unique_ptr<MetricBase> metric;
+    try {
+        metric = decoder_.decodeRecord(header_, payload);
+    } catch (const std::exception&) {
+        // Anything a corrupt payload makes a metric throw, bad_alloc from a wild size included
+        corrupt();
+        return false;
+    }
+    if (metric) {
+        num_metrics_++;
+        on_metric_(header_, std::move(metric));
+    } else {
+        num_unknown_records_++;
+    }
+    return true;
+}
+
+void TelemetryStreamDecoder::finishRecord() {
+    if (--records_left_ > 0) {
+        header_words_received_ = 0;
+        state_ = State::kRecordHeader;
+        return;
+    }
+    if (frame_words_left_ != 0) {
+        corrupt();
+        return;
+    }
+    endFrame();
+}
+
+void TelemetryStreamDecoder::endFrame() {
+    num_frames_++;
+    history_.clear();
+    history_lost_ = 0;
+    state_ = State::kSeekFrame;
+}
+
+void TelemetryStreamDecoder::corrupt() {
+    // feed() rescans the frame's bytes once the current scan stops
+    state_ = State::kSeekFrame;
+    window_ = 0;
+    window_bytes_ = 0;
+    partial_word_ = 0;
+    partial_bytes_ = 0;
+    records_left_ = 0;
+    frame_words_left_ = 0;
+    header_words_received_ = 0;
+    payload_received_ = 0;
+    corrupted_ = true;
+}
@@ -65,50 +65,28 @@ void TpcConfigs::clear() {
 
 }
 
-std::vector<uint32_t> TpcConfigs::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Reserve space for efficiency
-    serialized_data.reserve(num_members_ + prescale_.size() + disc_threshold_0_.size() + disc_threshold_1_.size());
-
-    // Serialize the histogram metadata
-    auto data = Serializer<TpcConfigs>::serialize_tuple(member_tuple());
-    serialized_data.insert(serialized_data.end(), data.begin(), data.end());
-
-    // Trigger prescales
-    serialized_data.insert(serialized_data.end(), prescale_.begin(), prescale_.end());
-    // Disc channel thresholds
-    serialized_data.insert(serialized_data.end(), disc_threshold_0_.begin(), disc_threshold_0_.end());
-    serialized_data.insert(serialized_data.end(), disc_threshold_1_.begin(), disc_threshold_1_.end());
-
-    return serialized_data;
+std::array<uint32_t, TpcConfigs::kWireWords> TpcConfigs::serialize_array() const {
+    static_assert(Layout::matches<decltype(member_tuple()), decltype(prescale_), decltype(disc_threshold_0_),
+                                  decltype(disc_threshold_1_)>(),
+                  "TpcConfigs wire layout does not match its members");
+    std::array<uint32_t, kWireWords> words{};
+    // Serialize the scalar configs
+    auto it = Serializer<TpcConfigs>::pack_tuple(member_tuple(), words.begin());
+    // Trigger prescales and disc channel thresholds
+    Serializer<TpcConfigs>::pack_arrays(it, prescale_, disc_threshold_0_, disc_threshold_1_);
+    return words;
 }
 
-std::vector<uint32_t>::const_iterator TpcConfigs::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                             std::vector<uint32_t>::const_iterator end) {
-    auto it = begin;
-    // Need scalars first
-    if (static_cast<size_t>(std::distance(it, end)) < num_members_) {
-        throw std::runtime_error("Deserialization failed: Words received [" +
-            std::to_string(std::distance(it, end)) + "] but requires [" + std::to_string(num_members_) + "]");
-    }
-    it = Serializer<TpcConfigs>::deserialize_tuple(member_tuple(), begin, end);
-
-    auto copy_array = [&](auto& arr) {
-        using ArrayType = std::decay_t<decltype(arr)>;
-        static_assert(std::is_same_v<typename ArrayType::value_type, uint32_t>, "Array element type must be uint32_t");
-
-        if (static_cast<size_t>(std::distance(it, end)) < arr.size()) {
-            throw std::runtime_error("Deserialization failed: not enough data for array.");
-        }
-        std::copy(it, it + arr.size(), arr.begin());
-        it += arr.size();
-    };
-
-    copy_array(prescale_);
-    copy_array(disc_threshold_0_);
-    copy_array(disc_threshold_1_);
+void TpcConfigs::serialize_into(std::vector<uint32_t>& out) const {
+    auto words = serialize_array();
+    out.insert(out.end(), words.begin(), words.end());
+}
 
-    return it;
+const uint32_t* TpcConfigs::deserialize(const uint32_t* begin, const uint32_t* end) {
+    // Fixed size so one bounds check covers the scalars and every array
+    requireWords(begin, end, kWireWords, "TpcConfigs");
+    auto it = Serializer<TpcConfigs>::unpack_tuple(member_tuple(), begin);
+    return Serializer<TpcConfigs>::unpack_arrays(it, prescale_, disc_threshold_0_, disc_threshold_1_);
 }
 
 #ifdef USE_PYTHON
@@ -5,49 +5,83 @@
 #include "../include/tpc_monitor.h"
 #include <iostream>
 
-TpcMonitor::TpcMonitor() {
+TpcMonitor::TpcMonitor()
     // Initialize histograms with their specific configurations
-    charge_histograms.assign(NUM_CHARGE_CHANNELS, Histogram(1024, 4096, CHARGE_BINS));
-    light_histograms.assign(NUM_LIGHT_CHANNELS, Histogram(1596, 4096, LIGHT_BINS));
+    : charge_histograms(NUM_CHARGE_CHANNELS, 1024, 4096, CHARGE_BINS),
+      light_histograms(NUM_LIGHT_CHANNELS, 1596, 4096, LIGHT_BINS) {
+    charge_stats.assign(NUM_CHARGE_CHANNELS, RunningStats());
 }
 
 void TpcMonitor::clear() {
-    for (auto& hist : charge_histograms) hist.clear();
-    for (auto& hist : light_histograms) hist.clear();
+    charge_histograms.clear();
+    light_histograms.clear();
+    for (auto& stats : charge_stats) stats.clear();
 }
 
-std::vector<uint32_t> TpcMonitor::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Serialize each member object and append its data
-    for (const auto& hist : charge_histograms) {
-        auto hist_data = hist.serialize();
-        serialized_data.insert(serialized_data.end(), hist_data.begin(), hist_data.end());
+void TpcMonitor::fillEvent(const uint32_t* charge_samples, size_t num_charge_samples,
+                           const uint32_t* light_samples, size_t num_light_samples) {
+    if (charge_samples != nullptr) {
+        for (size_t ch = 0; ch < charge_histograms.getNumChannels(); ch++) {
+            const uint32_t* samples = charge_samples + ch * num_charge_samples;
+            charge_histograms.fill(ch, samples, num_charge_samples);
+            charge_stats[ch].add(samples, num_charge_samples);
+        }
     }
-    for (const auto& hist : light_histograms) {
-        auto hist_data = hist.serialize();
-        serialized_data.insert(serialized_data.end(), hist_data.begin(), hist_data.end());
+    if (light_samples != nullptr) {
+        for (size_t ch = 0; ch < light_histograms.getNumChannels(); ch++) {
+            light_histograms.fill(ch, light_samples + ch * num_light_samples, num_light_samples);
+        }
     }
-    serialized_data.insert(serialized_data.end(), channel_mean.begin(), channel_mean.end());
-    serialized_data.insert(serialized_data.end(), channel_stddev.begin(), channel_stddev.end());
-    return serialized_data;
 }
 
-std::vector<uint32_t>::const_iterator TpcMonitor::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                             std::vector<uint32_t>::const_iterator end) {
-    auto it = begin;
-    // Let each histogram deserialize its own part of the data stream
-    for (auto& hist : charge_histograms) {
-        it = hist.deserialize(it, end);
+void TpcMonitor::fillEventPacked(const uint32_t* charge_words, size_t num_charge_samples,
+                                 const uint32_t* light_words, size_t num_light_samples) {
+    const size_t charge_stride = (num_charge_samples + 1) / 2;
+    const size_t light_stride = (num_light_samples + 1) / 2;
+    if (charge_words != nullptr) {
+        for (size_t ch = 0; ch < charge_histograms.getNumChannels(); ch++) {
+            const uint32_t* words = charge_words + ch * charge_stride;
+            charge_histograms.fillPacked(ch, words, num_charge_samples);
+            charge_stats[ch].addPacked(words, num_charge_samples);
+        }
     }
-    for (auto& hist : light_histograms) {
-        it = hist.deserialize(it, end);
+    if (light_words != nullptr) {
+        for (size_t ch = 0; ch < light_histograms.getNumChannels(); ch++) {
+            light_histograms.fillPacked(ch, light_words + ch * light_stride, num_light_samples);
+        }
     }
+}
 
-    // Copy charge channel mean/stddev data
-    std::copy(it, it + NUM_CHARGE_CHANNELS, channel_mean.begin());
-    it += NUM_CHARGE_CHANNELS;
-    std::copy(it, it + NUM_CHARGE_CHANNELS, channel_stddev.begin());
-    it += NUM_CHARGE_CHANNELS;
+void TpcMonitor::merge(const TpcMonitor& other) {
+    // Check both blocks first so a failed merge leaves this monitor untouched
+    if (!charge_histograms.isMergeable(other.charge_histograms) || !light_histograms.isMergeable(other.light_histograms)) {
+        throw std::invalid_argument("TpcMonitor merge failed: histogram channels or binning differ");
+    }
+    charge_histograms.merge(other.charge_histograms);
+    light_histograms.merge(other.light_histograms);
+    for (size_t ch = 0; ch < charge_stats.size(); ch++) charge_stats[ch].merge(other.charge_stats[ch]);
+}
+
+void TpcMonitor::serialize_into(std::vector<uint32_t>& out) const {
+    out.reserve(out.size() + charge_histograms.serializedWords() + light_histograms.serializedWords() +
+                2 * charge_stats.size());
+    charge_histograms.serialize_into(out);
+    light_histograms.serialize_into(out);
+    for (const auto& stats : charge_stats) out.push_back(RunningStats::toFixedPoint(stats.getMean()));
+    for (const auto& stats : charge_stats) out.push_back(RunningStats::toFixedPoint(stats.getStdDev()));
+}
+
+const uint32_t* TpcMonitor::deserialize(const uint32_t* begin, const uint32_t* end) {
+    auto it = charge_histograms.deserialize(begin, end);
+    it = light_histograms.deserialize(it, end);
+
+    // Charge channel mean/stddev, the number of samples behind them is the histogram entries
+    requireWords(it, end, 2 * NUM_CHARGE_CHANNELS, "TpcMonitor channel mean/stddev");
+    for (size_t ch = 0; ch < NUM_CHARGE_CHANNELS; ch++) {
+        charge_stats[ch] = RunningStats::fromSummary(charge_histograms.getEntries(ch), RunningStats::fromFixedPoint(it[ch]),
+                                                     RunningStats::fromFixedPoint(it[NUM_CHARGE_CHANNELS + ch]));
+    }
+    it += 2 * NUM_CHARGE_CHANNELS;
 
     return it;
 }
@@ -59,18 +93,24 @@ py::dict TpcMonitor::getMetricDict() {
     py::list charge_hist_list;
     py::list light_hist_list;
 
-    for (auto& hist : charge_histograms) {
+    for (const auto& hist : charge_histograms.views()) {
         charge_hist_list.append(hist.getMetricDict());
     }
-    for (auto& hist : light_histograms) {
+    for (const auto& hist : light_histograms.views()) {
         light_hist_list.append(hist.getMetricDict());
     }
 
     metric_dict["charge_hists"] = charge_hist_list;
     metric_dict["light_hists"] = light_hist_list;
 
-    metric_dict["charge_channel_mean"] = vector_to_numpy_array_1d(channel_mean);
-    metric_dict["charge_channel_stddev"] = vector_to_numpy_array_1d(channel_stddev);
+    py::array_t<double> channel_mean(charge_stats.size());
+    py::array_t<double> channel_stddev(charge_stats.size());
+    for (size_t ch = 0; ch < charge_stats.size(); ch++) {
+        channel_mean.mutable_at(ch) = charge_stats[ch].getMean();
+        channel_stddev.mutable_at(ch) = charge_stats[ch].getStdDev();
+    }
+    metric_dict["charge_channel_mean"] = channel_mean;
+    metric_dict["charge_channel_stddev"] = channel_stddev;
 
     return metric_dict;
 }
@@ -79,12 +119,12 @@ py::dict TpcMonitor::getMetricDict() {
 void TpcMonitor::print() const {
     std::cout << "++++++++++++++++ TpcMonitor ++++++++++++++++" << std::endl;
     std::cout << "Showing first charge histogram:" << std::endl;
-    if (!charge_histograms.empty()) {
-        charge_histograms.at(0).print();
+    if (charge_histograms.getNumChannels() > 0) {
+        charge_histograms.view(0).print();
     }
     std::cout << "Showing first light histogram:" << std::endl;
-    if (!light_histograms.empty()) {
-        light_histograms.at(0).print();
+    if (light_histograms.getNumChannels() > 0) {
+        light_histograms.view(0).print();
     }
     std::cout << "++++++++++++++++++++++++++++++++++++++++++++" << std::endl;
 }
\ No newline at end of file
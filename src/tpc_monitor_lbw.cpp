@@ -6,7 +6,8 @@
 #include <stdexcept>
 #include <iostream>
 
-LowBwTpcMonitor::LowBwTpcMonitor() : error_bit_word_(0), run_number_(0), file_number_(0), evt_number_(0) {
+LowBwTpcMonitor::LowBwTpcMonitor() : error_bit_word_(0), run_number_(0), file_number_(0), evt_number_(0),
+                                     num_processed_events_(0), num_skipped_events_(0) {
     std::fill(charge_baselines_.begin(), charge_baselines_.end(), 0);
     std::fill(charge_rms_.begin(), charge_rms_.end(), 0);
     std::fill(charge_avg_num_hits_.begin(), charge_avg_num_hits_.end(), 0);
@@ -19,6 +20,8 @@ void LowBwTpcMonitor::clear() {
     run_number_ = 0;
     file_number_ = 0;
     evt_number_ = 0;
+    num_processed_events_ = 0;
+    num_skipped_events_ = 0;
     std::fill(charge_baselines_.begin(), charge_baselines_.end(), 0);
     std::fill(charge_rms_.begin(), charge_rms_.end(), 0);
     std::fill(charge_avg_num_hits_.begin(), charge_avg_num_hits_.end(), 0);
@@ -27,52 +30,31 @@ void LowBwTpcMonitor::clear() {
     std::fill(light_avg_num_rois_.begin(), light_avg_num_rois_.end(), 0 );
 }
 
-std::vector<uint32_t> LowBwTpcMonitor::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Reserve space for efficiency
-    serialized_data.reserve(num_members_);
-
-    // Serialize the histogram metadata
-    auto data = Serializer<LowBwTpcMonitor>::serialize_tuple(member_tuple());
-    serialized_data.insert(serialized_data.end(), data.begin(), data.end());
-
-    // Charge channel number of samples data
-    serialized_data.insert(serialized_data.end(), charge_baselines_.begin(), charge_baselines_.end());
-    serialized_data.insert(serialized_data.end(), charge_rms_.begin(), charge_rms_.end());
-    serialized_data.insert(serialized_data.end(), charge_avg_num_hits_.begin(), charge_avg_num_hits_.end());
-    serialized_data.insert(serialized_data.end(), light_baselines_.begin(), light_baselines_.end());
-    serialized_data.insert(serialized_data.end(), light_rms_.begin(), light_rms_.end());
-    serialized_data.insert(serialized_data.end(), light_avg_num_rois_.begin(), light_avg_num_rois_.end());
-
-    return serialized_data;
+std::array<uint32_t, LowBwTpcMonitor::kWireWords> LowBwTpcMonitor::serialize_array() const {
+    static_assert(Layout::matches<decltype(member_tuple()), decltype(charge_baselines_), decltype(charge_rms_),
+                                  decltype(charge_avg_num_hits_), decltype(light_baselines_), decltype(light_rms_),
+                                  decltype(light_avg_num_rois_)>(),
+                  "LowBwTpcMonitor wire layout does not match its members");
+    std::array<uint32_t, kWireWords> words{};
+    // Serialize the metadata followed by the charge and light channel data
+    auto it = Serializer<LowBwTpcMonitor>::pack_tuple(member_tuple(), words.begin());
+    Serializer<LowBwTpcMonitor>::pack_arrays(it, charge_baselines_, charge_rms_, charge_avg_num_hits_,
+                                             light_baselines_, light_rms_, light_avg_num_rois_);
+    return words;
 }
 
-std::vector<uint32_t>::const_iterator LowBwTpcMonitor::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                            std::vector<uint32_t>::const_iterator end) {
-
-    auto it = begin;
-    it = Serializer<LowBwTpcMonitor>::deserialize_tuple(member_tuple(), begin, end);
-
-    // Ensure there's enough data for the bins
-    if (static_cast<size_t>(std::distance(it, end)) < (3*DOUBLE_PACK_CHARGE_CH + 3*DOUBLE_PACK_LIGHT_CH)) {
-        throw std::runtime_error("Deserialization failed: not enough data for 3*NUM_CHARGE_CH + 3*NUM_LIGHT_CH.");
-    }
+void LowBwTpcMonitor::serialize_into(std::vector<uint32_t>& out) const {
+    auto words = serialize_array();
+    out.insert(out.end(), words.begin(), words.end());
+}
 
-    // Copy num charge samples data
-    std::copy(it, it + DOUBLE_PACK_CHARGE_CH, charge_baselines_.begin());
-    it += DOUBLE_PACK_CHARGE_CH;
-    std::copy(it, it + DOUBLE_PACK_CHARGE_CH, charge_rms_.begin());
-    it += DOUBLE_PACK_CHARGE_CH;
-    std::copy(it, it + DOUBLE_PACK_CHARGE_CH, charge_avg_num_hits_.begin());
-    it += DOUBLE_PACK_CHARGE_CH;
-    std::copy(it, it+DOUBLE_PACK_LIGHT_CH, light_baselines_.begin());
-    it += DOUBLE_PACK_LIGHT_CH;
-    std::copy(it, it + DOUBLE_PACK_LIGHT_CH, light_rms_.begin());
-    it += DOUBLE_PACK_LIGHT_CH;
-    std::copy(it, it + DOUBLE_PACK_LIGHT_CH, light_avg_num_rois_.begin());
-    it += DOUBLE_PACK_LIGHT_CH;
+const uint32_t* LowBwTpcMonitor::deserialize(const uint32_t* begin, const uint32_t* end) {
 
-    return it;
+    // Fixed size so one bounds check covers every field
+    requireWords(begin, end, kWireWords, "LowBwTpcMonitor");
+    auto it = Serializer<LowBwTpcMonitor>::unpack_tuple(member_tuple(), begin);
+    return Serializer<LowBwTpcMonitor>::unpack_arrays(it, charge_baselines_, charge_rms_, charge_avg_num_hits_,
+                                                      light_baselines_, light_rms_, light_avg_num_rois_);
 }
 
 #ifdef USE_PYTHON
@@ -83,14 +65,16 @@ py::dict LowBwTpcMonitor::getMetricDict() {
     metric_dict["run_number"] = run_number_;
     metric_dict["file_number"] = file_number_;
     metric_dict["evt_number"] = evt_number_;
+    metric_dict["num_processed_events"] = num_processed_events_;
+    metric_dict["num_skipped_events"] = num_skipped_events_;
     // Charge channel metrics
-    metric_dict["charge_baseline"] = vector_to_numpy_array_1d(UnPackDoubleWords(charge_baselines_));
-    metric_dict["charge_rms"] = vector_to_numpy_array_1d(UnPackDoubleWords(charge_rms_));
-    metric_dict["charge_avg_num_hits"] = vector_to_numpy_array_1d(UnPackDoubleWords(charge_avg_num_hits_));
+    metric_dict["charge_baseline"] = packed_to_numpy_array_1d(SamplePacking::k16Bit, charge_baselines_.data(), charge_baselines_.size());
+    metric_dict["charge_rms"] = packed_to_numpy_array_1d(SamplePacking::k16Bit, charge_rms_.data(), charge_rms_.size());
+    metric_dict["charge_avg_num_hits"] = packed_to_numpy_array_1d(SamplePacking::k16Bit, charge_avg_num_hits_.data(), charge_avg_num_hits_.size());
     // Light channel metrics
-    metric_dict["light_baseline"] = vector_to_numpy_array_1d(UnPackDoubleWords(light_baselines_));
-    metric_dict["light_rms"] = vector_to_numpy_array_1d(UnPackDoubleWords(light_rms_));
-    metric_dict["light_avg_num_hits"] = vector_to_numpy_array_1d(UnPackDoubleWords(light_avg_num_rois_));
+    metric_dict["light_baseline"] = packed_to_numpy_array_1d(SamplePacking::k16Bit, light_baselines_.data(), light_baselines_.size());
+    metric_dict["light_rms"] = packed_to_numpy_array_1d(SamplePacking::k16Bit, light_rms_.data(), light_rms_.size());
+    metric_dict["light_avg_num_hits"] = packed_to_numpy_array_1d(SamplePacking::k16Bit, light_avg_num_rois_.data(), light_avg_num_rois_.size());
 
     return metric_dict;
 }
@@ -102,24 +86,29 @@ void LowBwTpcMonitor::print() {
     std::cout << "  run_number: " << run_number_ << std::endl;
     std::cout << "  file_number: " << file_number_ << std::endl;
     std::cout << "  evt_number: " << evt_number_ << std::endl;
+    std::cout << "  num_processed_events: " << num_processed_events_ << std::endl;
+    std::cout << "  num_skipped_events: " << num_skipped_events_ << std::endl;
+    // Unpack into stack buffers, print() shouldn't need the heap
+    std::array<uint32_t, 2 * DOUBLE_PACK_CHARGE_CH> charge_vals{};
+    std::array<uint32_t, 2 * DOUBLE_PACK_LIGHT_CH> light_vals{};
     std::cout << "  Charge Baselines (first 10): ";
-    auto tmp_vec = UnPackDoubleWords(charge_baselines_);
-    print_vec(tmp_vec);
+    UnPackDoubleWords(charge_baselines_, charge_vals.data());
+    print_array(charge_vals);
     std::cout << "  Charge RMS (first 10): ";
-    tmp_vec = UnPackDoubleWords(charge_rms_);
-    print_vec(tmp_vec);
+    UnPackDoubleWords(charge_rms_, charge_vals.data());
+    print_array(charge_vals);
     std::cout << "  Charge Avg Num Hits (first 10): ";
-    tmp_vec = UnPackDoubleWords(charge_avg_num_hits_);
-    print_vec(tmp_vec);
+    UnPackDoubleWords(charge_avg_num_hits_, charge_vals.data());
+    print_array(charge_vals);
     std::cout << "  Light Baselines (first 10): ";
-    tmp_vec = UnPackDoubleWords(light_baselines_);
-    print_vec(tmp_vec);
+    UnPackDoubleWords(light_baselines_, light_vals.data());
+    print_array(light_vals);
     std::cout << "  Light RMS (first 10): ";
-    tmp_vec = UnPackDoubleWords(light_rms_);
-    print_vec(tmp_vec);
+    UnPackDoubleWords(light_rms_, light_vals.data());
+    print_array(light_vals);
     std::cout << "  Light Avg Num ROIs (first 10): ";
-    tmp_vec = UnPackDoubleWords(light_avg_num_rois_);
-    print_vec(tmp_vec);
+    UnPackDoubleWords(light_avg_num_rois_, light_vals.data());
+    print_array(light_vals);
     std::cout << "..." << std::endl;
     std::cout << "++++++++++++++++++++++++++++++++++++++++++++" << std::endl;
 }
\ No newline at end of file
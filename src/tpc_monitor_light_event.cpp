@@ -15,27 +15,26 @@ void TpcMonitorLightEvent::clear() {
     file_number_ = 0;
     evt_number_ = 0;
     num_samples_ = 0;
-    // Repeated calls will be more efficient if we preserve the vector size. Hence, the choice of fill() over clear()
-    std::fill(light_samples_.begin(), light_samples_.end(), 0);
+    // Keeps the capacity, so setting samples of the same size again doesn't allocate
+    light_samples_.clear();
 }
 
-std::vector<uint32_t> TpcMonitorLightEvent::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Reserve space for efficiency
-    serialized_data.reserve(num_members_);
-    auto data = Serializer<TpcMonitorLightEvent>::serialize_tuple(member_tuple());
-    serialized_data.insert(serialized_data.end(), data.begin(), data.end());
+void TpcMonitorLightEvent::serialize_into(std::vector<uint32_t>& out) const {
+    static_assert(std::tuple_size_v<decltype(member_tuple())> == num_members_,
+                  "TpcMonitorLightEvent num_members_ does not match member_tuple()");
+    Serializer<TpcMonitorLightEvent>::serialize_tuple_into(member_tuple(), out);
 
     // Light channel number of samples data
-    serialized_data.insert(serialized_data.end(), light_samples_.begin(), light_samples_.end());
-
-    return serialized_data;
+    out.insert(out.end(), light_samples_.begin(), light_samples_.end());
 }
 
-std::vector<uint32_t>::const_iterator TpcMonitorLightEvent::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                            std::vector<uint32_t>::const_iterator end) {
+const uint32_t* TpcMonitorLightEvent::deserialize(const uint32_t* begin, const uint32_t* end) {
     auto it = begin;
     it = Serializer<TpcMonitorLightEvent>::deserialize_tuple(member_tuple(), begin, end);
+    if (!sample_packing::isValid(static_cast<uint8_t>(channel_number_ >> kPackingShift))) {
+        throw std::runtime_error("Deserialization failed: unknown sample packing " +
+                                 std::to_string(channel_number_ >> kPackingShift));
+    }
 
     // Ensure there's enough data for the bins
     if (static_cast<size_t>(std::distance(it, end)) < num_samples_) {
@@ -46,6 +45,8 @@ std::vector<uint32_t>::const_iterator TpcMonitorLightEvent::deserialize(std::vec
     light_samples_.resize(num_samples_);
     std::copy(it, it + num_samples_, light_samples_.begin());
     it += num_samples_;
+    // Throws if a packed payload does not match its sample count
+    sample_packing::numSamples(getPacking(), light_samples_.data(), light_samples_.size());
 
     return it;
 }
@@ -54,11 +55,12 @@ std::vector<uint32_t>::const_iterator TpcMonitorLightEvent::deserialize(std::vec
 py::dict TpcMonitorLightEvent::getMetricDict() {
 
     py::dict metric_dict;
-    metric_dict["channel_number"] = channel_number_;
+    metric_dict["channel_number"] = channel_number_ & kChannelMask;
+    metric_dict["packing"] = static_cast<int>(getPacking());
     metric_dict["run_number"] = run_number_;
     metric_dict["file_number"] = file_number_;
     metric_dict["evt_number"] = evt_number_;
-    metric_dict["light_samples"] = vector_to_numpy_array_1d(UnPackDoubleWords(light_samples_));
+    metric_dict["light_samples"] = packed_to_numpy_array_1d(getPacking(), light_samples_.data(), light_samples_.size());
 
     return metric_dict;
 }
@@ -66,15 +68,18 @@ py::dict TpcMonitorLightEvent::getMetricDict() {
 
 void TpcMonitorLightEvent::print() {
     std::cout << "++++++++++++ TpcMonitorLightEvent +++++++++++++" << std::endl;
-    std::cout << "  Channel: " << channel_number_ << std::endl;
+    std::cout << "  Channel: " << (channel_number_ & kChannelMask) << std::endl;
+    std::cout << "  Packing: " << static_cast<int>(getPacking()) << std::endl;
     std::cout << "  run_number: " << run_number_ << std::endl;
     std::cout << "  file_number: " << file_number_ << std::endl;
     std::cout << "  evt_number: " << evt_number_ << std::endl;
     std::cout << "  Number of samples: " << num_samples_ << std::endl;
     std::cout << "  Light Samples (first 10): ";
-    auto tmp_vec = UnPackDoubleWords(light_samples_);
-    for (size_t i = 0; i < 10; ++i) {
-        std::cout << tmp_vec[i] << (i == tmp_vec.size() - 1 ? "" : ", ");
+    std::array<uint32_t, 16> head{};
+    const size_t num_head = sample_packing::unpackHead(getPacking(), light_samples_.data(), light_samples_.size(),
+                                                       head.data(), head.size());
+    for (size_t i = 0; i < std::min<size_t>(10, num_head); ++i) {
+        std::cout << head[i] << (i == num_head - 1 ? "" : ", ");
     }
     std::cout << "..." << std::endl;
     std::cout << "++++++++++++++++++++++++++++++++++++++++++++" << std::endl;
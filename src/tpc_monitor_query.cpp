@@ -12,36 +12,24 @@ void TpcMonitorQuery::clear() {
     std::fill(fem_slots_.begin(), fem_slots_.end(), 0);
 }
 
-std::vector<uint32_t> TpcMonitorQuery::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Reserve space for efficiency
-    size_t num_words = NUM_FEMS;
-    serialized_data.reserve(num_words);
-
-    // Serialize the histogram metadata
-    // auto data = Serializer<LowBwTpcMonitor>::serialize_tuple(member_tuple());
-    // serialized_data.insert(serialized_data.end(), data.begin(), data.end());
+std::array<uint32_t, TpcMonitorQuery::kWireWords> TpcMonitorQuery::serialize_array() const {
+    static_assert(Layout::matches<decltype(fem_slots_)>(), "TpcMonitorQuery wire layout does not match its members");
+    std::array<uint32_t, kWireWords> words{};
     // Fill the Fem slots
-    serialized_data.insert(serialized_data.end(), fem_slots_.begin(), fem_slots_.end());
-    return serialized_data;
+    Serializer<TpcMonitorQuery>::pack_arrays(words.begin(), fem_slots_);
+    return words;
 }
 
-std::vector<uint32_t>::const_iterator TpcMonitorQuery::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                            std::vector<uint32_t>::const_iterator end) {
-
-    auto it = begin;
-    // it = Serializer<LowBwTpcMonitor>::deserialize_tuple(member_tuple(), begin, end);
-
-    // Ensure there's enough data for the bins
-    if (static_cast<size_t>(std::distance(it, end)) < NUM_FEMS) {
-        throw std::runtime_error("Deserialization failed: not enough data for Number charge channels.");
-    }
+void TpcMonitorQuery::serialize_into(std::vector<uint32_t>& out) const {
+    auto words = serialize_array();
+    out.insert(out.end(), words.begin(), words.end());
+}
 
-    // Copy num charge samples data
-    std::copy(it, it + NUM_FEMS, fem_slots_.begin());
-    it += NUM_FEMS;
+const uint32_t* TpcMonitorQuery::deserialize(const uint32_t* begin, const uint32_t* end) {
 
-    return it;
+    // Fixed size so one bounds check covers every field
+    requireWords(begin, end, kWireWords, "TpcMonitorQuery");
+    return Serializer<TpcMonitorQuery>::unpack_arrays(begin, fem_slots_);
 }
 
 #ifdef USE_PYTHON
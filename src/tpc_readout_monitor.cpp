@@ -5,7 +5,6 @@
 #include "../include/tpc_readout_monitor.h"
 #include <stdexcept>
 #include <iostream>
-#include <sstream>
 
 TpcReadoutMonitor::TpcReadoutMonitor() : error_bit_word_(0), num_rw_buffer_overflow_(0), readout_state_(0),
     last_command_(0), last_command_status_(0), run_number_(0), num_events_upper_(0),
@@ -42,37 +41,27 @@ void TpcReadoutMonitor::clear() {
     std::fill(board_status_.begin(), board_status_.end(), 0);
 }
 
-std::vector<uint32_t> TpcReadoutMonitor::serialize() const {
-    std::vector<uint32_t> serialized_data;
-    // Reserve space for efficiency
-    serialized_data.reserve(num_members_ + NUM_BOARDS);
-
-    // Serialize the histogram metadata
-    auto data = Serializer<TpcReadoutMonitor>::serialize_tuple(member_tuple());
-    serialized_data.insert(serialized_data.end(), data.begin(), data.end());
-    // Charge channel number of samples data
-    serialized_data.insert(serialized_data.end(), board_status_.begin(), board_status_.end());
-    return serialized_data;
+std::array<uint32_t, TpcReadoutMonitor::kWireWords> TpcReadoutMonitor::serialize_array() const {
+    static_assert(Layout::matches<decltype(member_tuple()), decltype(board_status_)>(),
+                  "TpcReadoutMonitor wire layout does not match its members");
+    std::array<uint32_t, kWireWords> words{};
+    // Serialize the metadata followed by the board status
+    auto it = Serializer<TpcReadoutMonitor>::pack_tuple(member_tuple(), words.begin());
+    Serializer<TpcReadoutMonitor>::pack_arrays(it, board_status_);
+    return words;
 }
 
-std::vector<uint32_t>::const_iterator TpcReadoutMonitor::deserialize(std::vector<uint32_t>::const_iterator begin,
-                                                            std::vector<uint32_t>::const_iterator end) {
-
-    auto it = begin;
-    it = Serializer<TpcReadoutMonitor>::deserialize_tuple(member_tuple(), begin, end);
-
-    // Ensure there's enough data for the bins
-    if (static_cast<size_t>(std::distance(it, end)) < NUM_BOARDS) {
-        std::ostringstream oss;
-        oss << "Deserialization failed: not enough data for Board Status " << static_cast<size_t>(std::distance(it, end));
-        throw std::runtime_error(oss.str());
-    }
+void TpcReadoutMonitor::serialize_into(std::vector<uint32_t>& out) const {
+    auto words = serialize_array();
+    out.insert(out.end(), words.begin(), words.end());
+}
 
-    // Copy num charge samples data
-    std::copy(it, it + NUM_BOARDS, board_status_.begin());
-    it += NUM_BOARDS;
+const uint32_t* TpcReadoutMonitor::deserialize(const uint32_t* begin, const uint32_t* end) {
 
-    return it;
+    // Fixed size so one bounds check covers every field
+    requireWords(begin, end, kWireWords, "TpcReadoutMonitor");
+    auto it = Serializer<TpcReadoutMonitor>::unpack_tuple(member_tuple(), begin);
+    return Serializer<TpcReadoutMonitor>::unpack_arrays(it, board_status_);
 }
 
 #ifdef USE_PYTHON
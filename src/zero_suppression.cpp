@@ -0,0 +1,65 @@
+//
+// Zero suppression of charge waveform snapshots with the per-channel baseline and RMS.
+//
+
+#include "../include/zero_suppression.h"
+#include "../include/lbw_stats_engine.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+ZeroSuppressionConfig ZeroSuppressionConfig::fromTpcConfigs(const TpcConfigs& configs) {
+    ZeroSuppressionConfig config;
+    config.pre_samples = configs.getRoiPrecount();
+    config.post_samples = configs.getNumRoiWords() > configs.getRoiPrecount()
+                              ? configs.getNumRoiWords() - configs.getRoiPrecount() : 0;
+    return config;
+}
+
+ZeroSuppressor::ZeroSuppressor(const ZeroSuppressionConfig& config) : config_(config) {
+    if (!(config_.threshold_sigma >= 0.0)) {
+        throw std::invalid_argument("ZeroSuppressor threshold_sigma must not be negative, got " +
+                                    std::to_string(config_.threshold_sigma));
+    }
+    thresholds_.fill(config_.min_threshold);
+}
+
+void ZeroSuppressor::setChannels(const LowBwTpcMonitor& monitor) {
+    std::array<uint32_t, 2 * DOUBLE_PACK_CHARGE_CH> baselines;
+    std::array<uint32_t, 2 * DOUBLE_PACK_CHARGE_CH> rms;
+    LowBwTpcMonitor::UnPackDoubleWords(monitor.getChargeBaselines(), baselines.data());
+    LowBwTpcMonitor::UnPackDoubleWords(monitor.getChargeRms(), rms.data());
+    for (size_t ch = 0; ch < NUM_CHARGE_CHANNELS; ch++) {
+        setChannel(ch, baselines[ch], rms[ch] / LbwStatsEngine::kScale);
+    }
+}
+
+void ZeroSuppressor::setChannel(size_t channel, uint32_t baseline, double rms) {
+    if (channel >= NUM_CHARGE_CHANNELS) {
+        throw std::out_of_range("ZeroSuppressor channel " + std::to_string(channel) + " out of range");
+    }
+    baselines_[channel] = baseline;
+    const double threshold = std::ceil(config_.threshold_sigma * rms);
+    // Clamp so a corrupt RMS can't wrap the threshold
+    thresholds_[channel] = threshold < config_.min_threshold ? config_.min_threshold
+                           : static_cast<uint32_t>(std::min(threshold, 65535.0));
+}
+
+SamplePacking ZeroSuppressor::encode(size_t channel, const uint32_t* samples, size_t num_samples,
+                                     std::vector<uint32_t>& out) const {
+    if (channel >= NUM_CHARGE_CHANNELS) {
+        throw std::out_of_range("ZeroSuppressor channel " + std::to_string(channel) + " out of range");
+    }
+    return sample_packing::packZeroSuppressed(samples, num_samples, baselines_[channel], thresholds_[channel],
+                                              config_.pre_samples, config_.post_samples, out);
+}
+
+void ZeroSuppressor::setChargeSamples(TpcMonitorChargeEvent& event, const std::vector<uint32_t>& samples) const {
+    const size_t channel = event.channel_number();
+    if (channel >= NUM_CHARGE_CHANNELS) {
+        throw std::out_of_range("ZeroSuppressor channel " + std::to_string(channel) + " out of range");
+    }
+    event.setChargeSamplesZeroSuppressed(samples, baselines_[channel], thresholds_[channel],
+                                         config_.pre_samples, config_.post_samples);
+}